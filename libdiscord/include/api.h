@@ -1,34 +1,48 @@
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include "common.h"
 
 namespace discord
 {
   class ConnectionState;
 
-  /** Struct for holding API responses. Includes status code and JSON data. */
+  /** Struct for holding API responses. Includes status code and JSON data.
+   *
+   *  The body is parsed in place, so strings in data point into the body instead of being copied,
+   *  and the rest of data comes from an allocator sized to the body. Responses can't be copied.
+   *  They are handed out as shared pointers, so callers of a shared or cached request all read the
+   *  same parse. A response that was handed out must not be modified.
+   */
   struct APIResponse
   {
+  private:
+    //  Declared before data, so they outlive it.
+    std::unique_ptr<std::string> m_body;
+    std::unique_ptr<rapidjson::MemoryPoolAllocator<>> m_allocator;
+  public:
+    /** The smallest chunk the allocator of a response grabs at a time. */
+    static const size_t MIN_CHUNK_SIZE;
+
     rapidjson::Document data;
     uint16_t status_code;
 
-    APIResponse()
-    {
-      status_code = 0;
-    }
+    APIResponse();
 
-    APIResponse(const APIResponse& other)
-    {
-      data.CopyFrom(other.data, data.GetAllocator());
-      status_code = other.status_code;
-    }
+    /** Parse a response body in place.
+     *
+     * @param status_code The status code of the response.
+     * @param body The body of the response, which is kept for as long as the response. If empty, data is left null.
+     */
+    APIResponse(uint16_t status_code, std::string body);
 
-    APIResponse& operator=(const APIResponse& other)
-    {
-      data.CopyFrom(other.data, data.GetAllocator());
-      status_code = other.status_code;
-      return *this;
-    }
+    APIResponse(APIResponse&& other) = default;
+    APIResponse& operator=(APIResponse&& other);
+
+    APIResponse(const APIResponse&) = delete;
+    APIResponse& operator=(const APIResponse&) = delete;
   };
 
   /** Responses that the Discord API can send. */
@@ -116,8 +130,44 @@ namespace discord
     User_UID,
   };
 
+  /** Struct for holding what the gateway/bot endpoint says about connecting to the gateway. */
+  struct GatewayInfo
+  {
+    std::string url;
+
+    /** The recommended amount of shards to connect with. */
+    int shards;
+
+    /** How many identifies can be sent in total before session_start_limit resets. */
+    int total_identifies;
+
+    /** How many identifies are left before session_start_limit resets. */
+    int remaining_identifies;
+
+    /** Milliseconds until the session start limit resets. */
+    int reset_after;
+
+    /** How many shards can identify at the same time. */
+    int max_concurrency;
+
+    GatewayInfo()
+    {
+      shards = 1;
+      total_identifies = 1000;
+      remaining_identifies = 1000;
+      reset_after = 0;
+      max_concurrency = 1;
+    }
+  };
+
   namespace api
   {
+    /** Get the gateway URL along with sharding and session start limits from Discord.
+      *
+      * @return The gateway information for this bot.
+      */
+    GatewayInfo get_gateway_bot(ConnectionState& conn);
+
     /** Get a secure websocket URL from Discord. *
       *
       * @return A WSS URL that can be used to connect to the Discord gateway.
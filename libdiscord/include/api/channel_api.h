@@ -2,6 +2,7 @@
 #include "channel.h"
 #include "embed.h"
 #include "message.h"
+#include "paginator.h"
 
 namespace discord
 {
@@ -49,6 +50,17 @@ namespace discord
        */
       pplx::task<std::vector<Message>> get_messages(ConnectionState* conn, Snowflake channel_id, int32_t limit = 50, SearchMethod method = SearchMethod::None, Snowflake pivot = 0);
 
+      /** Walks the message history of a channel a page at a time.
+       *
+       * @param channel_id The channel to walk.
+       * @param method Before to walk from newer to older messages, or After to walk from older to newer.
+       * @param start The message to start from. When walking back, zero starts from the newest message.
+       * @param page_size The amount of messages in each page. Must be between 1 and 100 inclusive.
+       * @param read_ahead How many pages to request before they are asked for.
+       * @return A paginator over the messages.
+       */
+      Paginator<Message> iterate_messages(ConnectionState* conn, Snowflake channel_id, SearchMethod method = SearchMethod::Before, Snowflake start = 0, int32_t page_size = 100, size_t read_ahead = 1);
+
       /** Get a single message from a channel.
        *
        * @param channel_id The channel to get the message from.
@@ -99,9 +111,22 @@ namespace discord
        * @param channel_id The channel where the message was reacted to.
        * @param message_id The message to get the list of reaction users from.
        * @param emoji The emoji that we should get the user list for.
+       * @param limit The amount of users to get. Must be between 1 and 100 inclusive.
+       * @param after The user to list users after. Used for pagination.
        * @return A list of users who reacted with the given emoji.
        */
-      pplx::task<std::vector<User>> get_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji);
+      pplx::task<std::vector<User>> get_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji, uint32_t limit = 25, Snowflake after = 0);
+
+      /** Walks every user who reacted to a message with a particular emoji, a page at a time.
+       *
+       * @param channel_id The channel where the message was reacted to.
+       * @param message_id The message to walk the reaction users of.
+       * @param emoji The emoji to walk the users of.
+       * @param page_size The amount of users in each page. Must be between 1 and 100 inclusive.
+       * @param read_ahead How many pages to request before they are asked for.
+       * @return A paginator over the users.
+       */
+      Paginator<User> iterate_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji, uint32_t page_size = 100, size_t read_ahead = 1);
 
       /** Deletes all reactions on a message.
        *
@@ -135,6 +160,17 @@ namespace discord
        */
       pplx::task<bool> bulk_remove_messages(ConnectionState* conn, Snowflake channel_id, std::vector<Snowflake> message_ids);
 
+      /** Delete any number of messages from a channel, walking back from the newest.
+       *
+       *  Messages are bulk deleted 100 at a time while the next pages are fetched. Messages too old
+       *  to bulk delete are deleted one at a time, as fast as their rate limit allows.
+       *
+       * @param channel_id The channel to delete messages from.
+       * @param options Which messages to delete.
+       * @return What the purge did. Messages that failed to delete are counted rather than thrown.
+       */
+      pplx::task<PurgeResult> purge_messages(ConnectionState* conn, Snowflake channel_id, PurgeOptions options = PurgeOptions());
+
       /** Edits the permissions of either a member or a role.
        *
        * @param channel_id The channel whose permissions will be updated.
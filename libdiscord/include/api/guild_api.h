@@ -1,7 +1,9 @@
 #pragma once
 
+#include "bulk_moderation.h"
 #include "common.h"
 #include "guild.h"
+#include "paginator.h"
 
 namespace discord
 {
@@ -79,6 +81,15 @@ namespace discord
        */
       pplx::task<std::vector<Member>> get_members(ConnectionState* conn, Snowflake guild_id, uint32_t limit = 1, Snowflake after = 0);
 
+      /** Walks every member of the guild a page at a time, in order of their ids.
+       *
+       * @param guild_id The guild to walk the members of.
+       * @param page_size The amount of members in each page. Can be between 1-1000 inclusive.
+       * @param read_ahead How many pages to request before they are asked for.
+       * @return A paginator over the members.
+       */
+      Paginator<Member> iterate_members(ConnectionState* conn, Snowflake guild_id, uint32_t page_size = 1000, size_t read_ahead = 1);
+
       /** Adds a member to a guild. Requires an OAuth2 access token.
        *
        * @param guild_id The guild to add the user to.
@@ -139,9 +150,20 @@ namespace discord
       /** Get a list of bans that the guild has.
        *
        * @param guild_id The guild to list bans from.
+       * @param limit The amount of bans to list, or 0 to let Discord decide.
+       * @param after The id of the user to list bans after. Used for pagination.
        * @return A list of bans that are currently active in the guild.
        */
-      pplx::task<std::vector<User>> get_bans(ConnectionState* conn, Snowflake guild_id);
+      pplx::task<std::vector<User>> get_bans(ConnectionState* conn, Snowflake guild_id, uint32_t limit = 0, Snowflake after = 0);
+
+      /** Walks every ban of the guild a page at a time, in order of the banned users' ids.
+       *
+       * @param guild_id The guild to walk the bans of.
+       * @param page_size The amount of bans in each page. Can be between 1-1000 inclusive.
+       * @param read_ahead How many pages to request before they are asked for.
+       * @return A paginator over the banned users.
+       */
+      Paginator<User> iterate_bans(ConnectionState* conn, Snowflake guild_id, uint32_t page_size = 1000, size_t read_ahead = 1);
 
       /** Bans a member from the guild.
        *
@@ -160,6 +182,45 @@ namespace discord
        */
       pplx::task<bool> unban(ConnectionState* conn, Snowflake guild_id, Snowflake user_id);
 
+      /** Bans many members from the guild, as fast as the rate limit allows.
+       *
+       * @param guild_id The guild to ban the members from.
+       * @param user_ids The members to ban.
+       * @param delete_x_days Number of days worth of messages to delete. Can be from 0-7.
+       * @param progress Called as each ban completes. Optional.
+       * @return The running bans, which can be cancelled.
+       */
+      BulkModeration bulk_ban(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, uint32_t delete_x_days = 0, BulkModeration::ProgressHandler progress = nullptr);
+
+      /** Removes many members from the guild, as fast as the rate limit allows.
+       *
+       * @param guild_id The guild to remove the members from.
+       * @param user_ids The members to remove.
+       * @param progress Called as each removal completes. Optional.
+       * @return The running removals, which can be cancelled.
+       */
+      BulkModeration bulk_kick(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, BulkModeration::ProgressHandler progress = nullptr);
+
+      /** Adds a role to many members, as fast as the rate limit allows.
+       *
+       * @param guild_id The guild where the members and role are.
+       * @param user_ids The members to add the role to.
+       * @param role_id The role to add.
+       * @param progress Called as each member completes. Optional.
+       * @return The running changes, which can be cancelled.
+       */
+      BulkModeration bulk_add_role(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress = nullptr);
+
+      /** Removes a role from many members, as fast as the rate limit allows.
+       *
+       * @param guild_id The guild where the members and role are.
+       * @param user_ids The members to remove the role from.
+       * @param role_id The role to remove.
+       * @param progress Called as each member completes. Optional.
+       * @return The running changes, which can be cancelled.
+       */
+      BulkModeration bulk_remove_role(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress = nullptr);
+
       /** Gets a list of roles that belong to the guild.
        *
        * @param guild_id The guild to get the roles from.
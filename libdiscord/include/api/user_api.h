@@ -3,6 +3,7 @@
 #include "common.h"
 #include "channel.h"
 #include "connection.h"
+#include "paginator.h"
 #include "user.h"
 
 namespace discord
@@ -38,6 +39,14 @@ namespace discord
        */
       pplx::task<std::vector<user_guild>> guilds(ConnectionState* conn, uint32_t limit = 100, SearchMethod method = SearchMethod::None, Snowflake guild_id = 0);
 
+      /** Walks every guild this user is in a page at a time, in order of their ids.
+       *
+       * @param page_size The amount of guilds in each page. Can be between 1-100 inclusive.
+       * @param read_ahead How many pages to request before they are asked for.
+       * @return A paginator over the guilds.
+       */
+      Paginator<user_guild> iterate_guilds(ConnectionState* conn, uint32_t page_size = 100, size_t read_ahead = 1);
+
       /** Leaves a guild.
        *
        * @param guild_id The guild to leave.
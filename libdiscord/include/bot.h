@@ -1,8 +1,13 @@
 #pragma once
 
 #include <unordered_map>
+#include <pplx/pplxtasks.h>
 
+#include "api.h"
+#include "cluster.h"
 #include "common.h"
+#include "dispatch_event.h"
+#include "latency_histogram.h"
 
 namespace discord
 {
@@ -13,6 +18,7 @@ namespace discord
   class Emoji;
   class Gateway;
   class Guild;
+  class HttpTransport;
   class Presence;
   class User;
 
@@ -41,7 +47,14 @@ namespace discord
 
     void on_event(EventType type, rapidjson::Value& data);
   public:
-    explicit Bot(std::string token, std::string prefix = "", int shards = 1);
+    /** Creates a Bot that is ready to be run.
+     *
+     * @param token The Bot's token, without "Bot" prepended.
+     * @param prefix The prefix that commands start with.
+     * @param shards The amount of shards to connect with, or 0 to use the amount Discord recommends.
+     * @param encoding The encoding the gateway should use. ETF payloads are smaller and faster to decode.
+     */
+    explicit Bot(std::string token, std::string prefix = "", int shards = 1, Encoding encoding = Encoding::JSON);
     ~Bot();
 
     /** Get the Bot's current token. *
@@ -142,6 +155,97 @@ namespace discord
      */
     void add_command(std::string name, std::function<void(MessageEvent)> callback);
 
+    /** Drop an event before it is parsed, even if the cache uses it. Events that no handler or
+     *  cache update uses are already dropped, this is for events like PRESENCE_UPDATE where a
+     *  stale cache is an acceptable cost.
+     *
+     * @param event The event to drop.
+     */
+    void ignore_event(DispatchEvent event);
+
+    /** Only handle events from a set of guilds. Events from other guilds are dropped before they are parsed,
+     *  so those guilds are never cached either.
+     *
+     * @param guilds The guilds to handle events from, or empty to handle every guild.
+     */
+    void allow_guilds(const std::vector<Snowflake>& guilds);
+
+    /** Get the heartbeat round trip times of a shard, for monitoring connection health.
+     *
+     * @param shard The shard to get the latency of.
+     * @return A summary of the shard's recent heartbeat round trips.
+     */
+    LatencyStats latency(int shard = 0) const;
+
+    /** Set how many heartbeat ACKs a shard can miss in a row before its connection is
+     *  treated as dead and resumed. Defaults to 1.
+     *
+     * @param max_missed_acks The amount of missed ACKs allowed, at least 1.
+     */
+    void set_max_missed_acks(uint32_t max_missed_acks);
+
+    /** Set the member count at which a guild is considered large. GUILD_CREATE for a large guild
+     *  only lists the members that are online, use request_members to load the rest. Defaults to 100.
+     *  Must be called before run.
+     *
+     * @param threshold The member count, between 50 and 250.
+     */
+    void set_large_threshold(uint8_t threshold);
+
+    /** Load every member of a set of guilds into the cache over the gateway. This is much faster
+     *  than paging through members with the REST API. Requests are batched and throttled per shard,
+     *  so it is fine to ask for every guild at once. Must be called after run.
+     *
+     * @param guild_ids The guilds to load the members of.
+     * @return A task that finishes with the amount of members received once every guild is loaded.
+     */
+    pplx::task<uint32_t> request_members(const std::vector<Snowflake>& guild_ids);
+
+    /** Only run some of the shards, so the rest can run in other processes. Needs the shard count to be
+     *  set in the constructor. Must be called before run.
+     *
+     * @param first The first shard to run.
+     * @param last One past the last shard to run.
+     */
+    void set_shard_range(int first, int last);
+
+    /** Join a cluster run by a ClusterCoordinator. The coordinator picks the shards this process runs
+     *  and keeps every process from identifying at the same time. Must be called before run.
+     *
+     * @param path The path of the coordinator's Unix socket.
+     * @param name The name of this process, without spaces.
+     */
+    void join_cluster(const std::string& path, const std::string& name);
+
+    /** Find which shard and process of the cluster handle a guild.
+     *
+     * @param guild_id The guild.
+     * @return The guild's shard and the name of the process running it.
+     */
+    GuildOwner guild_owner(Snowflake guild_id) const;
+
+    /** Replace how REST requests are sent. The default sends them with cpprest, a FakeTransport
+     *  answers them without touching the network. Must be called before any requests are made.
+     *
+     * @param transport The transport to send requests with.
+     */
+    void set_http_transport(std::unique_ptr<HttpTransport> transport);
+
+    /** Set how long the responses of a GET route are cached. Users, members, roles, bans, pins and
+     *  voice regions are cached by default, and dropped early when a gateway event changes them.
+     *
+     * @param key The route.
+     * @param ttl How long to keep its responses, or zero to stop caching it.
+     */
+    void set_cache_ttl(APIKey key, std::chrono::milliseconds ttl);
+
+    /** Keep gateway sessions on disk so restarting the Bot resumes them instead of identifying again.
+     *  Must be called before run.
+     *
+     * @param directory An existing directory to keep the session files in.
+     */
+    void persist_sessions(const std::string& directory);
+
     /** Runs the Bot.
      *
      * @param async Whether to run the Bot asynchronously or not. Default will block.
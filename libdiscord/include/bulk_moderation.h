@@ -0,0 +1,125 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <pplx/pplxtasks.h>
+
+#include "api.h"
+
+namespace discord
+{
+  class ConnectionState;
+
+  /** The outcome of one target of a bulk moderation action, along with the totals so far. */
+  struct ModerationProgress
+  {
+    /** The user the action was taken on. */
+    Snowflake user_id;
+
+    bool succeeded;
+
+    /** Why the action failed, or empty if it succeeded. */
+    std::string error;
+
+    /** How many targets are done, including this one. */
+    size_t completed;
+
+    /** How many targets failed so far. */
+    size_t failed;
+
+    /** How many targets there are in all. */
+    size_t total;
+  };
+
+  /** A target that a bulk moderation action failed on. */
+  struct ModerationFailure
+  {
+    Snowflake user_id;
+    std::string error;
+  };
+
+  /** What a bulk moderation action did once it finished or was cancelled. */
+  struct ModerationResult
+  {
+    size_t succeeded;
+    std::vector<ModerationFailure> failures;
+
+    /** How many targets were never tried because the action was cancelled. */
+    size_t skipped;
+
+    ModerationResult() : succeeded(0), skipped(0)
+    {
+    }
+  };
+
+  /** Applies one moderation action, such as a ban, to many users.
+   *
+   *  Requests are kept in flight up to the limit of the route's rate limit bucket, so each window is
+   *  used in full without piling thousands of requests into the rate limiter. While the limit isn't
+   *  known yet a single request is sent to find out. Failures are reported and skipped over rather
+   *  than stopping the run. Copies share the same run.
+   */
+  class BulkModeration
+  {
+  public:
+    /** Takes the action on a single user. */
+    using Action = std::function<pplx::task<bool>(Snowflake user_id)>;
+
+    /** Called once for every target as it completes. Calls are never concurrent, but can come from any thread. */
+    using ProgressHandler = std::function<void(const ModerationProgress&)>;
+
+    /** The most requests kept in flight, however large the bucket is. */
+    static const size_t MAX_CONCURRENCY;
+
+  private:
+    struct State
+    {
+      std::mutex mutex;
+      ConnectionState* conn;
+      APIKey key;
+      Snowflake major;
+      Action action;
+      std::vector<Snowflake> targets;
+      size_t next;
+      size_t in_flight;
+      bool cancelled;
+      ModerationResult result;
+      pplx::task_completion_event<ModerationResult> done;
+
+      //  Serializes calls to the progress handler.
+      std::mutex progress_mutex;
+      ProgressHandler progress;
+    };
+
+    std::shared_ptr<State> m_state;
+
+    /** Starts as many targets as the bucket allows, or finishes the run once nothing is left. */
+    static void pump(std::shared_ptr<State> state);
+
+    /** Takes the action on one target and records how it went. */
+    static void run(std::shared_ptr<State> state, Snowflake user_id);
+  public:
+    /** Start a bulk moderation action.
+     *
+     * @param conn The connection to send requests through.
+     * @param key The API key of the route the action uses.
+     * @param major The major parameter of the route, which is the guild for every moderation route.
+     * @param user_ids The users to take the action on.
+     * @param action Takes the action on a single user.
+     * @param progress Called as each target completes. Optional.
+     */
+    BulkModeration(ConnectionState* conn, APIKey key, Snowflake major, std::vector<Snowflake> user_ids, Action action, ProgressHandler progress = nullptr);
+
+    /** Stop starting new targets. Targets already in flight still finish. */
+    void cancel();
+
+    /** Get what the action did.
+     *
+     * @return A task that finishes once every target is done, or the run was cancelled and the last one in flight is done.
+     */
+    pplx::task<ModerationResult> result() const;
+  };
+}
@@ -4,7 +4,9 @@
 
 #include "common.h"
 #include "embed.h"
+#include "paginator.h"
 #include "permission.h"
+#include "purge.h"
 #include "user.h"
 
 namespace discord
@@ -179,6 +181,16 @@ namespace discord
      */
     pplx::task<std::vector<Message>> get_messages(int32_t limit = 50, SearchMethod method = SearchMethod::None, Snowflake pivot = 0) const;
 
+    /** Walks the message history of this channel a page at a time.
+     *
+     * @param method Before to walk from newer to older messages, or After to walk from older to newer.
+     * @param start The message to start from. When walking back, zero starts from the newest message.
+     * @param page_size The amount of messages in each page.
+     * @param read_ahead How many pages to request before they are asked for.
+     * @return A paginator over the messages.
+     */
+    Paginator<Message> iterate_messages(SearchMethod method = SearchMethod::Before, Snowflake start = 0, int32_t page_size = 100, size_t read_ahead = 1) const;
+
     /** Gets a message given its id.
      *
      * @param message_id The id of the message to get.
@@ -244,6 +256,16 @@ namespace discord
     */
     pplx::task<std::vector<User>> get_reactions(Snowflake message_id, Emoji emoji) const;
 
+    /** Walks every user who reacted to a message with a particular emoji, a page at a time.
+    *
+    * @param message_id The message to walk the reaction users of.
+    * @param emoji The emoji to walk the users of.
+    * @param page_size The amount of users in each page.
+    * @param read_ahead How many pages to request before they are asked for.
+    * @return A paginator over the users.
+    */
+    Paginator<User> iterate_reactions(Snowflake message_id, Emoji emoji, uint32_t page_size = 100, size_t read_ahead = 1) const;
+
     /** Deletes all reactions on a message.
     *
     * @param message_id The message to delete all reactions on.
@@ -272,12 +294,20 @@ namespace discord
     */
     pplx::task<bool> remove_messages(std::vector<Snowflake> message_ids) const;
 
-    /** Delete a set amount of messages from a channel all at once.
-    * @param amount The amount of messages to delete. Must be between 2 and 100 inclusive.
+    /** Delete a set amount of the newest messages from a channel.
+    * @param amount The amount of messages to delete. Must be at least 1.
+    * @return True if every message was deleted.
     * @throw DiscordException on invalid amount.
     */
     pplx::task<bool> remove_messages(int amount = 2) const;
 
+    /** Delete any number of messages from this channel, walking back from the newest.
+    *
+    * @param options Which messages to delete.
+    * @return What the purge did.
+    */
+    pplx::task<PurgeResult> purge_messages(PurgeOptions options = PurgeOptions()) const;
+
     /** Edits the permissions of either a member or a role.
     *
     * @param overwrite The overwrite to update.
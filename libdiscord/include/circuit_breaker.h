@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "api.h"
+
+namespace discord
+{
+  /** Stops sending requests to a route while Discord keeps failing them.
+   *
+   *  Each route's circuit opens after FAILURE_THRESHOLD failures in a row, and requests to it fail
+   *  right away instead of piling up. After OPEN_DURATION a single request is let through to probe the
+   *  route. If it succeeds the circuit closes, otherwise it stays open for another OPEN_DURATION.
+   */
+  class CircuitBreaker
+  {
+  public:
+    /** How many failures in a row open a circuit. */
+    static const uint32_t FAILURE_THRESHOLD;
+
+    /** How long a circuit stays open before it is probed. */
+    static const std::chrono::milliseconds OPEN_DURATION;
+
+  private:
+    struct Circuit
+    {
+      uint32_t failures;
+      std::chrono::steady_clock::time_point open_until;
+      bool probing;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<int, Circuit> m_circuits;
+  public:
+    /** Check whether a request to a route may be sent.
+     *
+     * @param key The route.
+     * @return False if the route's circuit is open.
+     */
+    bool allow(APIKey key);
+
+    /** Record that a request to a route got a response that wasn't a server error.
+     *
+     * @param key The route.
+     */
+    void record_success(APIKey key);
+
+    /** Record that a request to a route failed with a server error or no response.
+     *
+     * @param key The route.
+     */
+    void record_failure(APIKey key);
+  };
+}
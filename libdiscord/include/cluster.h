@@ -0,0 +1,166 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace discord
+{
+  /** The shards that a process runs, out of the shards of the whole bot. */
+  struct ShardRange
+  {
+    /** The first shard of the range. */
+    int first;
+
+    /** One past the last shard of the range. */
+    int last;
+
+    /** The total amount of shards across every process. */
+    int total;
+  };
+
+  /** Where a guild's events are handled in a cluster. */
+  struct GuildOwner
+  {
+    /** The shard that the guild belongs to. */
+    int shard;
+
+    /** The name of the process running that shard, or empty if no process is running it. */
+    std::string process;
+  };
+
+  /** Hands out shard ranges to the processes of a cluster, and keeps them from identifying at the
+   *  same time.
+   *
+   *  Processes talk to the coordinator over a Unix socket with one line of text per message:
+   *
+   *    JOIN <name>                        ->  RANGE <first> <last> <total>, or ERROR <reason>
+   *    IDENTIFY <shard> <max_concurrency> ->  DELAY <milliseconds>
+   *    OWNER <guild id>                   ->  OWNER <shard> [<name>]
+   *
+   *  Each process gets the first range that no process holds. When a process disconnects, its
+   *  range is free for the next one to join, so a restarted process picks up where it left off.
+   *  Identifies are spaced the same way IdentifyScheduler spaces them within one process, but for
+   *  every process at once.
+   */
+  class ClusterCoordinator
+  {
+    /** A connected process. */
+    struct Client
+    {
+      int fd;
+      std::string name;
+      std::string buffer;
+      int range;
+    };
+
+    std::string m_path;
+    int m_total_shards;
+    int m_shards_per_process;
+
+    int m_listen_fd;
+    int m_wake_fds[2];
+    std::thread m_thread;
+
+    std::vector<Client> m_clients;
+    std::vector<int> m_range_owners;
+    std::vector<std::chrono::steady_clock::time_point> m_bucket_ready;
+
+    /** Serves clients until stopped. */
+    void run();
+
+    /** Handles one line from a client.
+     *
+     * @param client The client that sent the line.
+     * @param line The line, without its newline.
+     * @return The reply to send back.
+     */
+    std::string handle(Client& client, const std::string& line);
+
+    /** Disconnects a client and frees its range.
+     *
+     * @param index The index of the client.
+     */
+    void drop(size_t index);
+  public:
+    /** Create a coordinator for a bot.
+     *
+     * @param path The path of the Unix socket to listen on. An existing file there is replaced.
+     * @param total_shards The total amount of shards across every process.
+     * @param shards_per_process How many shards each process runs.
+     */
+    ClusterCoordinator(const std::string& path, int total_shards, int shards_per_process);
+    ~ClusterCoordinator();
+
+    ClusterCoordinator(const ClusterCoordinator&) = delete;
+    ClusterCoordinator& operator=(const ClusterCoordinator&) = delete;
+
+    /** Start listening for processes on a background thread.
+     *  Throws a DiscordException if the socket can't be created.
+     */
+    void start();
+
+    /** Stop listening and disconnect every process. */
+    void stop();
+  };
+
+  /** A process's connection to a ClusterCoordinator. Requests wait for their reply, which is a
+   *  round trip on a local socket.
+   */
+  class ClusterClient
+  {
+    std::mutex m_mutex;
+    int m_fd;
+    std::string m_buffer;
+
+    /** Sends a line and waits for the reply. The mutex must be held.
+     *  Throws a DiscordException if the coordinator can't be reached or doesn't reply in time.
+     *
+     * @param line The line to send, without a newline.
+     * @return The reply, without its newline.
+     */
+    std::string request(const std::string& line);
+  public:
+    /** How long to wait for a reply from the coordinator. */
+    static const std::chrono::milliseconds REPLY_TIMEOUT;
+
+    /** Connect to a coordinator.
+     *  Throws a DiscordException if the coordinator can't be reached.
+     *
+     * @param path The path of the coordinator's Unix socket.
+     */
+    explicit ClusterClient(const std::string& path);
+    ~ClusterClient();
+
+    ClusterClient(const ClusterClient&) = delete;
+    ClusterClient& operator=(const ClusterClient&) = delete;
+
+    /** Join the cluster and get the shards that this process should run.
+     *  Throws a DiscordException if no range is free.
+     *
+     * @param name The name of this process, without spaces. Other processes see it in GuildOwner.
+     * @return The shards to run.
+     */
+    ShardRange join(const std::string& name);
+
+    /** Ask how long a shard has to wait before it may identify.
+     *
+     * @param shard The shard that wants to identify.
+     * @param max_concurrency How many shards may identify at once.
+     * @return How long to wait.
+     */
+    std::chrono::milliseconds identify_delay(int shard, int max_concurrency);
+
+    /** Find which process handles a guild.
+     *
+     * @param guild_id The guild.
+     * @return The guild's shard and the process running it.
+     */
+    GuildOwner owner(Snowflake guild_id);
+  };
+}
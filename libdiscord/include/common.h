@@ -42,6 +42,13 @@ namespace discord
     DEL
   };
 
+  /** Encodings that the gateway can use for its payloads. */
+  enum class Encoding
+  {
+    JSON,
+    ETF
+  };
+
   std::string json_to_string(rapidjson::Value& data);
   std::string json_to_string(const rapidjson::Value& data);
 
@@ -83,7 +90,7 @@ namespace discord
     }
     else
     {
-      value = Snowflake(iter->value.GetString());
+      value = Snowflake(iter->value);
     }
   }
 }
\ No newline at end of file
@@ -1,38 +1,58 @@
 #pragma once
 
+#include <array>
 #include <map>
 #include <unordered_map>
 
 #include "api.h"
 #include "channel.h"
+#include "circuit_breaker.h"
+#include "cluster.h"
 #include "common.h"
+#include "dispatch_event.h"
+#include "event_filter.h"
 #include "gateway.h"
+#include "http_transport.h"
+#include "identify_scheduler.h"
+#include "member_requester.h"
+#include "rate_limiter.h"
+#include "response_cache.h"
 #include "user.h"
 
-//  Convoluted forward declaration
-namespace web
-{
-  namespace http
-  {
-    namespace client
-    {
-      class http_client;
-    }
-  }
-}
-
 namespace discord
 {
   class ConnectionState
   {
     std::string m_token;
     int m_shards;
+    int m_first_shard;
+    int m_last_shard;
+    Encoding m_encoding;
+    std::string m_session_directory;
+    uint32_t m_max_missed_acks;
+    uint8_t m_large_threshold;
+    EventFilter m_filter;
+
+    std::unique_ptr<HttpTransport> m_transport;
 
-    std::mutex m_global_mutex;
-    std::unordered_map<size_t, std::unique_ptr<std::mutex>> m_api_locks;
-    web::http::client::http_client* m_client;
+    /** Drives heartbeats and reconnects for every shard from one thread. Must outlive m_gateways. */
+    TimerWheel m_timers;
+    IdentifyScheduler m_identify;
+    MemberRequester m_member_requester;
+    RateLimiter m_rate_limiter;
+    CircuitBreaker m_breaker;
+    ResponseCache m_cache;
 
+    //  GETs that are in flight, by path. Identical GETs made meanwhile wait here for the same response.
+    std::mutex m_gets_mutex;
+    std::unordered_map<std::string, std::vector<pplx::task_completion_event<std::shared_ptr<APIResponse>>>> m_pending_gets;
+    std::unique_ptr<ClusterClient> m_cluster;
+
+    /** The gateways of shards m_first_shard up to m_last_shard, in order. */
     std::vector<std::unique_ptr<Gateway>> m_gateways;
+
+    /** Timers that start the gateways of later identify rounds. They point at m_gateways. */
+    std::vector<TimerWheel::TimerId> m_start_timers;
     std::unique_ptr<User> m_profile;
     std::map<uint64_t, Guild> m_guilds;
     std::unordered_map<uint64_t, Channel> m_private_channels;
@@ -41,6 +61,39 @@ namespace discord
     std::unordered_map<uint64_t, uint64_t> m_channel_guilds;
 
     std::function<void(EventType, rapidjson::Value& data)> m_event_handler;
+    std::function<void(Guild&)> m_guild_created_handler;
+
+    /** How many times a REST request is sent before a server error or network failure is given up on. */
+    static const uint32_t MAX_ATTEMPTS;
+
+    /** How many 429 responses a REST request can get before it is given up on. */
+    static const uint32_t MAX_RATE_LIMIT_RETRIES;
+
+    /** The delay before the first retry of a failed REST request. Each retry waits twice as long as the last. */
+    static const std::chrono::milliseconds RETRY_BASE_DELAY;
+
+    /** The longest delay between retries of a failed REST request. */
+    static const std::chrono::milliseconds RETRY_MAX_DELAY;
+
+    /** A REST request, kept until it has a final response or is given up on. */
+    struct RestCall;
+
+    /** Sends a REST request once its rate limit bucket allows and its route's circuit is closed.
+     *  Requests that are rate limited, or fail with a server error, are sent again.
+     *
+     * @param call The request to send.
+     */
+    void send_request(std::shared_ptr<RestCall> call);
+
+    /** Sends a failed REST request again after a backoff, or fails it if it is out of attempts.
+     *
+     * @param call The request that failed.
+     * @param reason Why the request failed.
+     */
+    void retry_request(std::shared_ptr<RestCall> call, const std::string& reason);
+
+    /** Drops cached REST responses that a dispatch event says are out of date. */
+    void invalidate_cache(DispatchEvent event, rapidjson::Value& data);
 
     /** Raises an event to the registered event handler if applicable.
      *
@@ -49,24 +102,158 @@ namespace discord
      */
     void raise_event(EventType type, rapidjson::Value& data) const;
 
+    //  Handlers for each dispatch event that updates the cache or raises an event.
+    void handle_ready(rapidjson::Value& data);
+    void handle_channel_create(rapidjson::Value& data);
+    void handle_channel_update(rapidjson::Value& data);
+    void handle_channel_delete(rapidjson::Value& data);
+    void handle_guild_create(rapidjson::Value& data);
+    void handle_guild_update(rapidjson::Value& data);
+    void handle_guild_delete(rapidjson::Value& data);
+    void handle_guild_ban_add(rapidjson::Value& data);
+    void handle_guild_ban_remove(rapidjson::Value& data);
+    void handle_guild_emojis_update(rapidjson::Value& data);
+    void handle_guild_integrations_update(rapidjson::Value& data);
+    void handle_guild_member_add(rapidjson::Value& data);
+    void handle_guild_member_remove(rapidjson::Value& data);
+    void handle_guild_member_update(rapidjson::Value& data);
+    void handle_guild_members_chunk(rapidjson::Value& data);
+    void handle_guild_role_create(rapidjson::Value& data);
+    void handle_guild_role_update(rapidjson::Value& data);
+    void handle_guild_role_delete(rapidjson::Value& data);
+    void handle_message_create(rapidjson::Value& data);
+    void handle_message_update(rapidjson::Value& data);
+    void handle_message_delete(rapidjson::Value& data);
+    void handle_message_delete_bulk(rapidjson::Value& data);
+    void handle_presence_update(rapidjson::Value& data);
+    void handle_typing_start(rapidjson::Value& data);
+
+    /** Caches a guild that the gateway built while parsing its GUILD_CREATE.
+     *
+     * @param guild The guild, which is moved into the cache.
+     */
+    void handle_streamed_guild(Guild& guild);
+
+    /** Caches a new guild and passes it to the registered guild handler.
+     *
+     * @param guild The guild, which is moved into the cache.
+     */
+    void add_guild(Guild& guild);
+
+    using DispatchHandler = void (ConnectionState::*)(rapidjson::Value& data);
+    using DispatchTable = std::array<DispatchHandler, static_cast<size_t>(DispatchEvent::Count)>;
+
+    /** Handlers indexed by dispatch event. Events without a handler are null. */
+    static const DispatchTable DISPATCH_TABLE;
+
+    /** Builds the table of dispatch handlers.
+     *
+     * @return A table with every handled event filled in.
+     */
+    static DispatchTable build_dispatch_table();
+
     /** Called whenever a dispatch event is sent from the gateway.
     *
-    * @param event_name The name of the event that was sent.
+    * @param event The event that was sent.
     * @param data The data that the event contains.
     */
-    void on_dispatch(std::string event_name, rapidjson::Value& data);
+    void on_dispatch(DispatchEvent event, rapidjson::Value& data);
   public:
 	ConnectionState();
 
     /** Create a connection with a set number of shards.
      *
      * @param token The token for the Bot that is connecting.
-     * @param shards The amount of shards to use for this connection.
+     * @param shards The amount of shards to use for this connection, or 0 to use the amount Discord recommends.
+     * @param encoding The encoding the gateway should use for its payloads.
      */
-    ConnectionState(std::string token, int shards = 1);
+    ConnectionState(std::string token, int shards = 1, Encoding encoding = Encoding::JSON);
 
     ~ConnectionState();
 
+    /** Keep every shard's session in a file under a directory, so a restart can resume instead of identifying.
+     *  Must be called before connect.
+     *
+     * @param directory An existing directory to keep the session files in.
+     */
+    void persist_sessions(const std::string& directory);
+
+    /** Only run some of the shards, so the rest can run in other processes.
+     *  Must be called before connect, and needs a fixed shard count.
+     *
+     * @param first The first shard to run.
+     * @param last One past the last shard to run.
+     */
+    void set_shard_range(int first, int last);
+
+    /** Join a cluster, which decides the shards to run and spaces identifies across every process.
+     *  Must be called before connect. Throws a DiscordException if the coordinator can't be reached
+     *  or has no shards left.
+     *
+     * @param path The path of the ClusterCoordinator's Unix socket.
+     * @param name The name of this process, without spaces.
+     */
+    void join_cluster(const std::string& path, const std::string& name);
+
+    /** Find which shard and process handle a guild.
+     *  Throws a DiscordException if this process isn't in a cluster.
+     *
+     * @param guild_id The guild.
+     * @return The guild's shard and the process running it.
+     */
+    GuildOwner guild_owner(Snowflake guild_id);
+
+    /** Set how many heartbeat ACKs a shard can miss in a row before it is reconnected.
+     *
+     * @param max_missed_acks The amount of missed ACKs allowed, at least 1.
+     */
+    void set_max_missed_acks(uint32_t max_missed_acks);
+
+    /** Set the member count at which GUILD_CREATE stops listing offline members.
+     *
+     * @param threshold The member count, between 50 and 250.
+     */
+    void set_large_threshold(uint8_t threshold);
+
+    /** Load every member of a set of guilds into the cache over the gateway.
+     *
+     * @param guild_ids The guilds to load the members of.
+     * @return A task that finishes with the amount of members received.
+     */
+    pplx::task<uint32_t> request_members(const std::vector<Snowflake>& guild_ids);
+
+    /** Get the heartbeat round trip times of a shard.
+     *
+     * @param shard The shard to get the latency of.
+     * @return A summary of the shard's recent heartbeat round trips.
+     */
+    LatencyStats latency(int shard) const;
+
+    /** Get the filter that decides which dispatch events are parsed.
+     *
+     * @return The event filter shared by every shard.
+     */
+    EventFilter& filter();
+
+    /** Get the cache of REST responses, to change which routes are cached and for how long.
+     *
+     * @return The response cache.
+     */
+    ResponseCache& response_cache();
+
+    /** Get the rate limiter that REST requests go through.
+     *
+     * @return The rate limiter.
+     */
+    RateLimiter& rate_limiter();
+
+    /** Replace how REST requests are sent, for example with a FakeTransport in tests.
+     *  Must be called before any requests are made.
+     *
+     * @param transport The transport to send requests with.
+     */
+    void set_http_transport(std::unique_ptr<HttpTransport> transport);
+
     /** Starts the connection by connecting to as many gateways as requested. */
     void connect();
 
@@ -76,8 +263,9 @@ namespace discord
      * @param major The major parameter of the API call.
      * @param type The method to use when connecting to the API.
      * @param data The JSON payload to attach.
+     * @return The response, which may be shared with other callers and must not be modified.
      */
-    pplx::task<APIResponse> request(APIKey key, Snowflake major, Method type, std::string endpoint, const std::string&& data = "");
+    pplx::task<std::shared_ptr<APIResponse>> request(APIKey key, Snowflake major, Method type, std::string endpoint, const std::string&& data = "");
 
     /** Registers an event handler that will be called on certain gateway events.
      *
@@ -85,6 +273,12 @@ namespace discord
      */
     void on_event(std::function<void(EventType, rapidjson::Value& data)> callback);
 
+    /** Registers a handler that will be called with every guild that is created.
+     *
+     * @param callback A callback that accepts the guild as it is in the cache.
+     */
+    void on_guild_created(std::function<void(Guild&)> callback);
+
 
     /** Get the current token.
      *
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace discord
+{
+  /** Every dispatch event that the gateway can send, as a dense enumeration that can index a table. */
+  enum class DispatchEvent : uint8_t
+  {
+    Unknown,
+    Ready,
+    Resumed,
+    ChannelCreate,
+    ChannelUpdate,
+    ChannelDelete,
+    ChannelPinsUpdate,
+    GuildCreate,
+    GuildUpdate,
+    GuildDelete,
+    GuildBanAdd,
+    GuildBanRemove,
+    GuildEmojisUpdate,
+    GuildIntegrationsUpdate,
+    GuildMemberAdd,
+    GuildMemberRemove,
+    GuildMemberUpdate,
+    GuildMembersChunk,
+    GuildRoleCreate,
+    GuildRoleUpdate,
+    GuildRoleDelete,
+    MessageCreate,
+    MessageUpdate,
+    MessageDelete,
+    MessageDeleteBulk,
+    MessageReactionAdd,
+    MessageReactionRemove,
+    MessageReactionRemoveAll,
+    PresenceUpdate,
+    TypingStart,
+    UserUpdate,
+    VoiceStateUpdate,
+    VoiceServerUpdate,
+    WebhooksUpdate,
+    Count
+  };
+
+  /** Maps the name of a dispatch event to its enumeration value.
+   *
+   *  Uses a perfect hash that is built and checked at compile time, so a lookup costs one hash
+   *  and a single string comparison no matter which event it is.
+   *
+   * @param name The event name, as sent in the "t" field of a payload.
+   * @param length The length of the event name.
+   * @return The event, or DispatchEvent::Unknown if the name is not recognized.
+   */
+  DispatchEvent to_dispatch_event(const char* name, size_t length);
+
+  /** Get the name that the gateway uses for a dispatch event.
+   *
+   * @param event The event to get the name of.
+   * @return The event name, or "UNKNOWN".
+   */
+  const char* dispatch_event_name(DispatchEvent event);
+}
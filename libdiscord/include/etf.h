@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "json_pool.h"
+
+namespace discord
+{
+  namespace etf
+  {
+    //  Tags from the Erlang External Term Format that Discord uses.
+    enum Tag : uint8_t
+    {
+      NewFloat = 70,
+      SmallInteger = 97,
+      Integer = 98,
+      Float = 99,
+      Atom = 100,
+      SmallTuple = 104,
+      LargeTuple = 105,
+      Nil = 106,
+      String = 107,
+      List = 108,
+      Binary = 109,
+      SmallBig = 110,
+      LargeBig = 111,
+      SmallAtom = 115,
+      Map = 116,
+      AtomUtf8 = 118,
+      SmallAtomUtf8 = 119,
+      Version = 131
+    };
+
+    /** Decodes an ETF payload into a document as if it had been parsed from JSON.
+     *
+     *  Maps become objects, lists and tuples become arrays, binaries and atoms become strings
+     *  (except nil, true and false) and integers keep their numeric type. Snowflakes are sent
+     *  as integers over ETF, so they arrive as Uint64 values instead of strings.
+     *
+     *  Meant to be passed to PooledDocument::Populate.
+     */
+    class Decoder
+    {
+      const uint8_t* m_data;
+      size_t m_size;
+      size_t m_pos;
+      const char* m_error;
+
+      bool decode_term(PooledDocument& handler);
+      bool decode_key(PooledDocument& handler);
+      bool decode_atom(PooledDocument& handler, size_t length);
+      bool decode_big(PooledDocument& handler, size_t length);
+      bool fail(const char* error);
+      bool require(size_t bytes);
+      uint8_t read8();
+      uint16_t read16();
+      uint32_t read32();
+    public:
+      Decoder(const char* data, size_t size);
+
+      /** Sends the decoded payload to a document as SAX events.
+       *
+       * @param handler The document to populate.
+       * @return True if the whole payload was decoded.
+       */
+      bool operator()(PooledDocument& handler);
+
+      /** Get the reason that decoding failed.
+       *
+       * @return A description of the error, or nullptr if there was none.
+       */
+      const char* error() const;
+    };
+
+    /** A rapidjson handler that writes the values it is given as ETF.
+     *
+     *  Use it with rapidjson::Value::Accept. Objects are written as maps with binary keys,
+     *  arrays as lists and null as the nil atom.
+     */
+    class Encoder
+    {
+      std::vector<uint8_t>& m_buffer;
+      std::vector<size_t> m_positions;
+
+      void write8(uint8_t value);
+      void write32(uint32_t value);
+      void patch32(size_t pos, uint32_t value);
+      void write_atom(const char* name, uint8_t length);
+      void write_big(uint64_t value, bool negative);
+    public:
+      /** Creates an encoder that writes to the given buffer, after clearing it.
+       *
+       * @param buffer The buffer to write to. Its capacity is reused.
+       */
+      explicit Encoder(std::vector<uint8_t>& buffer);
+
+      /** Clears the buffer to start a new payload, keeping the capacity it has grown to. */
+      void reset();
+
+      bool Null();
+      bool Bool(bool b);
+      bool Int(int i);
+      bool Uint(unsigned u);
+      bool Int64(int64_t i);
+      bool Uint64(uint64_t u);
+      bool Double(double d);
+      bool RawNumber(const char* str, rapidjson::SizeType length, bool copy);
+      bool String(const char* str, rapidjson::SizeType length, bool copy);
+      bool StartObject();
+      bool Key(const char* str, rapidjson::SizeType length, bool copy);
+      bool EndObject(rapidjson::SizeType member_count);
+      bool StartArray();
+      bool EndArray(rapidjson::SizeType element_count);
+    };
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "dispatch_event.h"
+#include "snowflake.h"
+
+namespace discord
+{
+  /** Decides which dispatch events are worth parsing.
+   *
+   *  An event is kept if something consumes it, either the cache or a handler, and the user has
+   *  not asked to ignore it. If a guild allowlist is set, events from other guilds are dropped too.
+   *  Events without a guild always pass the allowlist. Ready and Resumed are never filtered.
+   *
+   *  Safe to read from any thread while it is being changed.
+   */
+  class EventFilter
+  {
+    std::atomic<uint64_t> m_consumed;
+    std::atomic<uint64_t> m_ignored;
+    std::shared_ptr<const std::unordered_set<uint64_t>> m_guilds;
+
+    static uint64_t bit(DispatchEvent event);
+  public:
+    EventFilter();
+
+    /** Mark an event as having a consumer.
+     *
+     * @param event The event that is consumed.
+     */
+    void consume(DispatchEvent event);
+
+    /** Drop an event even if it has a consumer. Things that depend on it, like parts of the
+     *  cache, will go stale.
+     *
+     * @param event The event to drop.
+     * @param ignore Whether to drop the event or not.
+     */
+    void ignore(DispatchEvent event, bool ignore = true);
+
+    /** Only keep events from a set of guilds.
+     *
+     * @param guilds The guilds to keep events from, or empty to keep events from every guild.
+     */
+    void allow_guilds(const std::vector<Snowflake>& guilds);
+
+    /** Check if a guild allowlist is set, in which case the guild of an event is needed to filter it. */
+    bool filters_guilds() const;
+
+    /** Check if an event should be parsed and dispatched.
+     *
+     * @param event The event.
+     * @param guild_id The guild the event is for, or 0 if it isn't for a guild.
+     * @return True if the event should be kept.
+     */
+    bool accepts(DispatchEvent event, uint64_t guild_id) const;
+  };
+}
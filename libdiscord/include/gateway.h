@@ -1,15 +1,37 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <cpprest/ws_client.h>
-#include <thread>
 
 #include "common.h"
+#include "dispatch_event.h"
+#include "etf.h"
+#include "event_filter.h"
+#include "guild_reader.h"
+#include "identify_scheduler.h"
+#include "json_pool.h"
+#include "latency_histogram.h"
+#include "mpsc_queue.h"
+#include "session_store.h"
+#include "timer_wheel.h"
+#include "token_bucket.h"
+#include "zlib_stream.h"
 
 namespace discord
 {
   struct BotData;
   class Bot;
+  struct PayloadHeader;
+
+  /** The ways that the gateway can compress payloads sent to us. */
+  enum class Compression
+  {
+    None,
+    Payload,
+    Stream
+  };
 
   class Gateway
   {
@@ -19,20 +41,81 @@ namespace discord
     web::websockets::client::websocket_callback_client m_client;
     std::mutex m_client_mutex;
 
+    //  Encoding and compression variables
+    Encoding m_encoding;
+    Compression m_compression;
+    ZlibStream m_inflater;
+
+    //  Timer variables, the wheel is shared by every shard
+    TimerWheel& m_timers;
+    IdentifyScheduler& m_identify;
+    TimerWheel::TimerId m_heartbeat_timer;
+    TimerWheel::TimerId m_identify_timer;
+    TimerWheel::TimerId m_reconnect_timer;
+    uint32_t m_reconnect_attempts;
+
     //  Heartbeat variables
-    std::thread m_heartbeat_thread;
     uint32_t m_heartbeat_interval;
     bool m_recieved_ack;
+    std::atomic<std::chrono::steady_clock::rep> m_heartbeat_sent;
+    std::atomic<uint32_t> m_missed_acks;
+    uint32_t m_max_missed_acks;
+    LatencyHistogram m_latency;
 
     //  Session variables
     uint32_t m_last_seq;
     std::string m_session_id;
     volatile bool m_connected;
+    volatile bool m_stopping;
     bool m_use_resume;
     int m_shard;
     int m_total_shards;
+    uint8_t m_large_threshold;
+    std::unique_ptr<SessionStore> m_session_store;
+
+    std::function<void(DispatchEvent, rapidjson::Value&)> m_on_dispatch = nullptr;
+    std::function<void(Guild&)> m_on_guild_create = nullptr;
+    std::unique_ptr<GuildReader> m_guild_reader;
+    const EventFilter* m_filter = nullptr;
+
+    /** A received frame on its way through the receive pipeline. Slots and their buffers are reused. */
+    struct ReceiveSlot
+    {
+      //  The raw frame, and once it's parsed, the text that the payload points into
+      std::vector<char> frame;
+      size_t size;
+      bool binary;
+      uint32_t generation;
+
+      //  The parsed payload, and the event to dispatch from it if there is one
+      JsonPool pool;
+      rapidjson::Value* data;
+      DispatchEvent event;
 
-    std::function<void(std::string, rapidjson::Value&)> m_on_dispatch = nullptr;
+      //  A guild that was built while parsing, in place of the data
+      std::unique_ptr<Guild> guild;
+
+      ReceiveSlot();
+    };
+
+    //  Receive pipeline variables. The socket thread reads frames into a ring of slots, one parser
+    //  task per shard decompresses and parses them, then one dispatch task per shard hands them to
+    //  the cache and handlers. Each stage only follows the one before it, so per-shard order holds.
+    //  Once handlers fall a full ring behind, frames go to a backlog instead of waiting for a slot.
+    //  The parser keeps up with the backlog, so heartbeat ACKs, reconnects and invalidated sessions
+    //  are handled as they arrive, while its dispatches wait for the ring to be dispatched first.
+    //  The socket thread never blocks, so a slow handler only costs memory until it catches up.
+    std::unique_ptr<ReceiveSlot[]> m_slots;
+    std::atomic<uint64_t> m_received;
+    std::atomic<uint64_t> m_parsed;
+    std::atomic<uint64_t> m_dispatched;
+    std::atomic<size_t> m_parse_pending;
+    std::atomic<size_t> m_dispatch_pending;
+    std::mutex m_backlog_mutex;
+    std::deque<std::unique_ptr<ReceiveSlot>> m_backlog;
+    size_t m_backlog_parsed;
+    std::atomic<uint32_t> m_generation;
+    uint32_t m_inflater_generation;
 
     //  Private enumeration for Opcodes
     enum Opcode : uint8_t
@@ -51,23 +134,185 @@ namespace discord
       Heartbeat_ACK
     };
 
+    /** A payload waiting to be serialized and sent by the sender. */
+    struct OutboundPayload
+    {
+      Opcode op;
+      rapidjson::Document data;
+    };
+
+    //  Outbound variables. Heartbeats, identify and resume are flags in m_priority_pending, one bit
+    //  per opcode, and are always sent first. Their data is written from the connection state when
+    //  they are sent, so queueing them never allocates. Only one sender drains at a time, which
+    //  m_send_pending tracks.
+    std::atomic<uint32_t> m_priority_pending;
+    MpscQueue<OutboundPayload> m_send_queue;
+    std::atomic<size_t> m_send_pending;
+
+    //  Holds SEND_LIMIT / 2 tokens. A full burst plus a whole period of refill adds up to SEND_LIMIT,
+    //  so no window of SEND_PERIOD can ever see more than SEND_LIMIT commands.
+    TokenBucket m_send_bucket;
+
+    //  Set while the sender waits for a token. Whoever clears it, the timer or the destructor, finishes the sender.
+    std::mutex m_send_timer_mutex;
+    TimerWheel::TimerId m_send_timer;
+
+    //  Reused by the sender for every payload. The parts of identify that never change are built once.
+    rapidjson::StringBuffer m_json_out;
+    rapidjson::Writer<rapidjson::StringBuffer> m_json_writer;
+    std::vector<uint8_t> m_etf_out;
+    etf::Encoder m_etf_writer;
+    rapidjson::Document m_identify_properties;
+
     void connect();
+    void schedule_reconnect();
     void on_message(web::websockets::client::websocket_incoming_message msg);
-    void handle_dispatch_event(std::string event_name, rapidjson::Value& data);
-    void send(Opcode op, rapidjson::Value& packet);
+    void parse_frames();
+    void parse_frame(ReceiveSlot& slot);
+
+    /** Reads the header of a payload without parsing it.
+     *
+     * @param data The payload.
+     * @param size The size of the payload.
+     * @param header Filled with the header of the payload.
+     * @return The event if the payload is clearly a dispatch, otherwise DispatchEvent::Unknown.
+     */
+    DispatchEvent scan_payload(const char* data, size_t size, PayloadHeader& header);
+
+    /** Checks a dispatch against the filter.
+     *
+     * @return True if the dispatch was filtered out and should be dropped.
+     */
+    bool filter_payload(DispatchEvent event, const PayloadHeader& header);
+
+    /** Builds the guild of a GUILD_CREATE while parsing it, and stores it in the slot. */
+    void read_guild(ReceiveSlot& slot, char* data, const PayloadHeader& header);
+    void set_last_seq(uint32_t seq);
+    void dispatch_events();
+
+    /** Handles the parts of a dispatch event that belong to the connection, like the session id.
+     *
+     * @return True if the event should be passed on to the dispatch callback.
+     */
+    bool handle_dispatch_event(DispatchEvent event, rapidjson::Value& data);
+    void drain_send_queue();
+
+    /** Serializes a payload into the sender's buffers and sends it.
+     *
+     * @param op The opcode of the payload.
+     * @param data The data of the payload, or nullptr for a priority payload built from the connection state.
+     */
+    void write_payload(Opcode op, const rapidjson::Value* data);
+
+    /** Writes the data of a heartbeat, identify or resume straight to a SAX handler. */
+    template <typename Handler>
+    void write_priority_data(Handler& handler, Opcode op);
+
+    /** Queue a payload to be sent. Never blocks, serialization and sending happen on the sender.
+     *
+     * @param op The opcode of the payload.
+     * @param packet The data of the payload.
+     */
+    void send(Opcode op, rapidjson::Document&& packet);
+
+    /** Mark a heartbeat, identify or resume as waiting to be sent. Queueing one that is already
+     *  waiting does nothing, it is only sent once.
+     *
+     * @param op The opcode of the payload.
+     */
+    void send_priority(Opcode op);
     void send_heartbeat();
+    void schedule_identify();
     void send_identify();
     void send_resume();
   public:
     //  Constants
     static const uint8_t LARGE_SERVER;
+    static const uint8_t MIN_LARGE_THRESHOLD;
+    static const uint8_t MAX_LARGE_THRESHOLD;
     static const utility::string_t VERSION;
-    static const utility::string_t ENCODING;
+    static const utility::string_t JSON_ENCODING;
+    static const utility::string_t ETF_ENCODING;
+    static const utility::string_t TRANSPORT_COMPRESSION;
+    static const std::chrono::milliseconds RECONNECT_BASE_DELAY;
+    static const std::chrono::milliseconds RECONNECT_MAX_DELAY;
+    static const uint32_t SEND_LIMIT;
+    static const std::chrono::milliseconds SEND_PERIOD;
+    static const uint32_t PRIORITY_RESERVE;
+    static const uint32_t DEFAULT_MAX_MISSED_ACKS;
+    static const size_t RECEIVE_SLOTS;
+    static const size_t SLOT_POOL_SIZE;
+    static const size_t SLOT_POOL_LIMIT;
 
-    explicit Gateway(utility::string_t wss_url, const std::string& token, int shard = 0, int total_shards = 1);
+    /** Create a gateway connection for a single shard.
+     *
+     * @param timers The timer wheel that drives heartbeats and reconnects. Must outlive the gateway.
+     * @param identify The scheduler that decides when this shard may identify. Must outlive the gateway.
+     * @param wss_url The websocket url to connect to.
+     * @param token The bot token.
+     * @param shard The shard this connection is for.
+     * @param total_shards The total amount of shards.
+     * @param encoding The encoding to use for payloads.
+     * @param compression The compression to ask the gateway for.
+     */
+    Gateway(TimerWheel& timers, IdentifyScheduler& identify, utility::string_t wss_url, const std::string& token, int shard = 0, int total_shards = 1,
+      Encoding encoding = Encoding::JSON, Compression compression = Compression::Stream);
+
+    /** Closes the connection and waits for the receive and send tasks that are queued to finish. */
+    ~Gateway();
+
+    /** Keep this shard's session in a file so a restarted process can resume it. Call before start.
+     *
+     *  A resumed session only replays the events that were missed, so the guild cache is not
+     *  filled from GUILD_CREATE the way it is after an identify.
+     *
+     * @param path The file to keep the session in.
+     */
+    void persist_session(const std::string& path);
 
     void start();
-    void on_dispatch(std::function<void(std::string, rapidjson::Value&)> callback);
+    void on_dispatch(std::function<void(DispatchEvent, rapidjson::Value&)> callback);
+
+    /** Build guilds from GUILD_CREATE while they are parsed, and pass them to a callback instead
+     *  of passing a document to on_dispatch. Only used with the JSON encoding.
+     *
+     * @param owner The connection state that the built objects belong to.
+     * @param callback The callback to pass each guild to.
+     */
+    void on_guild_create(ConnectionState* owner, std::function<void(Guild&)> callback);
+
+    /** Set a filter that dispatch events must pass before they are parsed.
+     *
+     * @param filter The filter to use, which must outlive the gateway, or nullptr to parse everything.
+     */
+    void set_filter(const EventFilter* filter);
     bool connected() const;
+
+    /** Get the heartbeat round trip times of this shard.
+     *
+     * @return A summary of recent heartbeat round trips.
+     */
+    LatencyStats latency() const;
+
+    /** Set how many heartbeats in a row can go without an ACK before the connection is
+     *  considered dead, closed and resumed.
+     *
+     * @param max_missed_acks The amount of missed ACKs allowed, at least 1.
+     */
+    void set_max_missed_acks(uint32_t max_missed_acks);
+
+    /** Set the member count at which a guild is large. GUILD_CREATE for a large guild only lists
+     *  members that are online, the rest have to be requested. Takes effect on the next identify.
+     *
+     * @param threshold The member count, between MIN_LARGE_THRESHOLD and MAX_LARGE_THRESHOLD.
+     */
+    void set_large_threshold(uint8_t threshold);
+
+    /** Request the members of guilds on this shard. They arrive as GUILD_MEMBERS_CHUNK events.
+     *
+     * @param guild_ids The guilds to request every member of. Each must belong to this shard.
+     * @param nonce A nonce that every chunk of the response will carry.
+     */
+    void request_members(const std::vector<Snowflake>& guild_ids, const std::string& nonce);
   };
 }
@@ -3,6 +3,7 @@
 #include <cpprest/http_client.h>
 #include <unordered_map>
 
+#include "bulk_moderation.h"
 #include "common.h"
 #include "connection_object.h"
 #include "emoji.h"
@@ -11,6 +12,7 @@
 #include "user.h"
 #include "voice.h"
 #include "integration.h"
+#include "paginator.h"
 #include "channel.h"
 
 namespace discord
@@ -70,6 +72,8 @@ namespace discord
 
   class Guild : public Identifiable, public ConnectionObject
   {
+    friend class GuildReader;
+
     std::string m_name;
     std::string m_icon;
     std::string m_splash;
@@ -340,6 +344,14 @@ namespace discord
     */
     pplx::task<std::vector<Member>> get_members(uint32_t limit = 1, Snowflake after = 0) const;
 
+    /** Walks every member of the guild a page at a time, in order of their ids.
+    *
+    * @param page_size The amount of members in each page. Can be between 1-1000 inclusive.
+    * @param read_ahead How many pages to request before they are asked for.
+    * @return A paginator over the members.
+    */
+    Paginator<Member> iterate_members(uint32_t page_size = 1000, size_t read_ahead = 1) const;
+
     /** Adds a member to a guild. Requires an OAuth2 access token.
     *
     * @param user_id The user to add to the guild.
@@ -397,6 +409,14 @@ namespace discord
     */
     pplx::task<std::vector<User>> get_bans() const;
 
+    /** Walks every ban of the guild a page at a time, in order of the banned users' ids.
+    *
+    * @param page_size The amount of bans in each page. Can be between 1-1000 inclusive.
+    * @param read_ahead How many pages to request before they are asked for.
+    * @return A paginator over the banned users.
+    */
+    Paginator<User> iterate_bans(uint32_t page_size = 1000, size_t read_ahead = 1) const;
+
     /** Bans a member from the guild.
     *
     * @param user_id The member to ban from the guild.
@@ -412,6 +432,41 @@ namespace discord
     */
     pplx::task<bool> unban(Snowflake user_id) const;
 
+    /** Bans many members from the guild, as fast as the rate limit allows.
+    *
+    * @param user_ids The members to ban.
+    * @param delete_x_days Number of days worth of messages to delete. Can be from 0-7.
+    * @param progress Called as each ban completes. Optional.
+    * @return The running bans, which can be cancelled.
+    */
+    BulkModeration bulk_ban(std::vector<Snowflake> user_ids, uint32_t delete_x_days = 0, BulkModeration::ProgressHandler progress = nullptr) const;
+
+    /** Removes many members from the guild, as fast as the rate limit allows.
+    *
+    * @param user_ids The members to remove.
+    * @param progress Called as each removal completes. Optional.
+    * @return The running removals, which can be cancelled.
+    */
+    BulkModeration bulk_kick(std::vector<Snowflake> user_ids, BulkModeration::ProgressHandler progress = nullptr) const;
+
+    /** Adds a role to many members, as fast as the rate limit allows.
+    *
+    * @param user_ids The members to add the role to.
+    * @param role_id The role to add.
+    * @param progress Called as each member completes. Optional.
+    * @return The running changes, which can be cancelled.
+    */
+    BulkModeration bulk_add_role(std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress = nullptr) const;
+
+    /** Removes a role from many members, as fast as the rate limit allows.
+    *
+    * @param user_ids The members to remove the role from.
+    * @param role_id The role to remove.
+    * @param progress Called as each member completes. Optional.
+    * @return The running changes, which can be cancelled.
+    */
+    BulkModeration bulk_remove_role(std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress = nullptr) const;
+
     /** Gets a list of roles that belong to the guild.
     *
     * @return A list of roles that belong to the guild.
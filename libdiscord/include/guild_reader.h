@@ -0,0 +1,169 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "guild.h"
+#include "json_pool.h"
+
+namespace discord
+{
+  class ConnectionState;
+
+  /** Builds a Guild from a GUILD_CREATE payload while it is being parsed.
+   *
+   *  Most of a large guild's GUILD_CREATE is its members, presences and channels. Parsing the
+   *  whole payload into a document first means all of it is held twice while the guild is built,
+   *  once as the document and once as objects. Instead, each element of those lists is parsed
+   *  into a small reused document and turned into an object right away. Only the rest of the
+   *  guild is ever held as a document, so memory use follows the objects and not the payload.
+   *
+   *  The SAX handler methods are public so the reader can call them, but are not meant to be
+   *  called directly. A reader is reused for every payload, and is not thread safe.
+   */
+  class GuildReader
+  {
+    /** The lists of a guild that are built one element at a time. */
+    enum class List
+    {
+      None,
+      Roles,
+      Emojis,
+      Channels,
+      Members,
+      Presences,
+      VoiceStates
+    };
+
+    /** What the reader has to start building after the event it just handled. */
+    enum class Pending
+    {
+      None,
+      Guild,
+      Element
+    };
+
+    /** Passes an object in the payload to a document as a generator of SAX events. */
+    struct Subtree
+    {
+      GuildReader& reader;
+
+      bool operator()(PooledDocument& document);
+    };
+
+    //  Nesting of the payload: the envelope, the guild in "d", one of its lists, then an element.
+    static const int ENVELOPE_DEPTH;
+    static const int GUILD_DEPTH;
+    static const int LIST_DEPTH;
+    static const int ELEMENT_DEPTH;
+
+    ConnectionState* m_owner;
+    rapidjson::Reader m_reader;
+    rapidjson::InsituStringStream m_stream;
+
+    //  The guild without its lists, and the list element currently being read
+    JsonPool m_guild_pool;
+    JsonPool m_element_pool;
+
+    //  Where SAX events are sent, or nullptr while in the envelope
+    PooledDocument* m_target;
+    int m_depth;
+    bool m_in_data;
+    Pending m_pending;
+    List m_list;
+    rapidjson::SizeType m_list_values;
+
+    //  The objects built from the lists so far
+    std::unordered_map<uint64_t, Role> m_roles;
+    std::unordered_map<uint64_t, Emoji> m_emojis;
+    std::unordered_map<uint64_t, Channel> m_channels;
+    std::unordered_map<uint64_t, Member> m_members;
+    std::unordered_map<uint64_t, Presence> m_presences;
+    std::vector<VoiceState> m_voice_states;
+
+    /** Finds the list that a key of the guild holds.
+     *
+     * @param key The key.
+     * @param length The length of the key.
+     * @return The list, or List::None if the key is not one of the lists.
+     */
+    static List to_list(const char* key, rapidjson::SizeType length);
+
+    /** Checks whether events are currently inside one of the lists of the guild. */
+    bool in_list() const;
+
+    /** Drops every object built from the lists. */
+    void clear();
+
+    /** Reads the next token of the payload.
+     *
+     * @return False if the payload is malformed or ended early.
+     */
+    bool next();
+
+    /** Sends every event of the object that was just started to a document, until it closes.
+     *
+     * @param document The document to build.
+     * @return False if the payload is malformed or ended early.
+     */
+    bool read_subtree(PooledDocument& document);
+
+    /** Reads the list element that was just started and builds its object.
+     *
+     * @return False if the payload is malformed or ended early.
+     */
+    bool read_element();
+
+    /** Counts a value that is passed on to the guild document as part of a list. Lists should
+     *  only hold objects, but anything else in them still has to be counted when the list closes.
+     */
+    void count_value();
+  public:
+    /** Create a reader for guilds that belong to a connection.
+     *
+     * @param owner The connection state given to every object that is built.
+     */
+    explicit GuildReader(ConnectionState* owner);
+
+    GuildReader(const GuildReader&) = delete;
+    GuildReader& operator=(const GuildReader&) = delete;
+
+    /** Builds the guild in the "d" of a GUILD_CREATE payload.
+     *
+     *  Strings are parsed in place, so the payload is modified.
+     *
+     * @param payload The null terminated text of the whole payload.
+     * @return The guild, or nullptr if the payload is malformed or has no guild in it.
+     */
+    std::unique_ptr<Guild> read(char* payload);
+
+    /** Get the reason the last read failed.
+     *
+     * @return The error code of the parser.
+     */
+    rapidjson::ParseErrorCode error() const;
+
+    /** Get where in the payload the last read failed.
+     *
+     * @return The offset of the error into the payload.
+     */
+    size_t error_offset() const;
+
+    bool Null();
+    bool Bool(bool b);
+    bool Int(int i);
+    bool Uint(unsigned u);
+    bool Int64(int64_t i);
+    bool Uint64(uint64_t u);
+    bool Double(double d);
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy);
+    bool String(const char* str, rapidjson::SizeType length, bool copy);
+    bool StartObject();
+    bool Key(const char* str, rapidjson::SizeType length, bool copy);
+    bool EndObject(rapidjson::SizeType member_count);
+    bool StartArray();
+    bool EndArray(rapidjson::SizeType element_count);
+  };
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pplx/pplxtasks.h>
+
+#include "common.h"
+
+//  Convoluted forward declaration
+namespace web
+{
+  namespace http
+  {
+    namespace client
+    {
+      class http_client;
+    }
+  }
+}
+
+namespace discord
+{
+  /** A REST request, relative to the base URL of the API. */
+  struct HttpRequest
+  {
+    Method method;
+
+    /** The path of the endpoint, along with its query string. */
+    std::string path;
+
+    /** The JSON body, or empty if there is none. */
+    std::string body;
+
+    /** The value of the Authorization header. */
+    std::string authorization;
+  };
+
+  /** The response to a REST request. */
+  struct HttpResponse
+  {
+    uint16_t status_code;
+
+    /** The headers of the response. Names are lowercase. */
+    std::unordered_map<std::string, std::string> headers;
+
+    std::string body;
+
+    HttpResponse() : status_code(0)
+    {
+    }
+
+    /** Find a header.
+     *
+     * @param name The name of the header, in lowercase.
+     * @return The value of the header, or nullptr if the response doesn't have it.
+     */
+    const std::string* header(const std::string& name) const;
+  };
+
+  /** Sends REST requests for a ConnectionState. Implementations must be safe to call from any thread. */
+  class HttpTransport
+  {
+  public:
+    virtual ~HttpTransport() {}
+
+    /** Send a request.
+     *
+     * @param request The request to send.
+     * @return A task that finishes with the response, or throws if no response was received.
+     */
+    virtual pplx::task<HttpResponse> send(const HttpRequest& request) = 0;
+  };
+
+  /** Settings for CpprestTransport. */
+  struct HttpTransportConfig
+  {
+    /** The base URL that request paths are relative to. */
+    std::string base_url;
+
+    /** How long a request can go without progress before it fails. */
+    std::chrono::milliseconds timeout;
+
+    /** How many clients requests are spread across. Each client keeps its own pool of connections alive. */
+    size_t clients;
+
+    /** The size of the chunks that bodies are read in. */
+    size_t chunk_size;
+
+    HttpTransportConfig();
+  };
+
+  /** The default transport, which sends requests with cpprest.
+   *
+   *  Connections are kept alive and reused between requests. Requests are spread across several
+   *  clients in turn, so one slow response never holds up the connections of the others.
+   */
+  class CpprestTransport : public HttpTransport
+  {
+    std::vector<std::unique_ptr<web::http::client::http_client>> m_clients;
+    std::atomic<size_t> m_next_client;
+  public:
+    explicit CpprestTransport(const HttpTransportConfig& config = HttpTransportConfig());
+    ~CpprestTransport();
+
+    pplx::task<HttpResponse> send(const HttpRequest& request) override;
+  };
+
+  /** A transport that never touches the network, for testing code that makes REST calls.
+   *  Every request is recorded, and answered by a handler.
+   */
+  class FakeTransport : public HttpTransport
+  {
+  public:
+    /** Answers a request. Throwing fails the request as if the network had. */
+    using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+  private:
+    mutable std::mutex m_mutex;
+    Handler m_handler;
+    std::vector<HttpRequest> m_requests;
+  public:
+    /** Create a fake transport.
+     *
+     * @param handler Answers requests. If empty, every request gets an empty 204 response.
+     */
+    explicit FakeTransport(Handler handler = nullptr);
+
+    pplx::task<HttpResponse> send(const HttpRequest& request) override;
+
+    /** Get every request sent so far.
+     *
+     * @return The requests, in the order they were sent.
+     */
+    std::vector<HttpRequest> requests() const;
+  };
+}
@@ -13,7 +13,7 @@ namespace discord
     explicit Identifiable(Snowflake id) : m_id(id) {}
     explicit Identifiable(rapidjson::Value& value)
     {
-      m_id = Snowflake(value.GetString());
+      m_id = Snowflake(value);
     }
 
     bool operator<(const Identifiable& rhs) const
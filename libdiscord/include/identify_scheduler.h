@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "timer_wheel.h"
+
+namespace discord
+{
+  /** Spaces out identifies so shards never trip the gateway's session start limits.
+   *
+   *  Discord lets max_concurrency shards identify at once. A shard's bucket is its id modulo
+   *  max_concurrency, and each bucket may only identify once every IDENTIFY_INTERVAL. Buckets
+   *  don't affect each other, so they run in parallel. Identifies that would exceed the daily
+   *  limit wait for it to reset.
+   */
+  class IdentifyScheduler
+  {
+  public:
+    /** Reserves an identify for a shard somewhere else, such as with the other processes of a cluster.
+     *
+     * @param shard The shard that wants to identify.
+     * @param max_concurrency How many shards can identify at the same time.
+     * @return How long the shard has to wait.
+     */
+    using RemoteDelay = std::function<std::chrono::milliseconds(int shard, int max_concurrency)>;
+
+  private:
+    TimerWheel& m_timers;
+    std::mutex m_mutex;
+
+    int m_max_concurrency;
+    std::vector<std::chrono::steady_clock::time_point> m_bucket_ready;
+
+    int m_total_identifies;
+    int m_remaining_identifies;
+    std::chrono::steady_clock::time_point m_limit_reset;
+
+    RemoteDelay m_remote;
+
+    /** Reserves the next identify of a shard's bucket.
+     *
+     * @param shard The shard that wants to identify.
+     * @return How long the shard has to wait.
+     */
+    std::chrono::milliseconds reserve(int shard);
+  public:
+    /** How long a bucket must wait between identifies. */
+    static const std::chrono::milliseconds IDENTIFY_INTERVAL;
+
+    /** How long a session start limit period lasts. */
+    static const std::chrono::hours LIMIT_PERIOD;
+
+    explicit IdentifyScheduler(TimerWheel& timers);
+
+    /** Set the limits reported by the gateway/bot endpoint.
+     *
+     * @param max_concurrency How many shards can identify at the same time.
+     * @param total How many identifies are allowed for each reset period.
+     * @param remaining How many identifies are left in this reset period.
+     * @param reset_after How long until the reset period ends.
+     */
+    void set_limits(int max_concurrency, int total, int remaining, std::chrono::milliseconds reset_after);
+
+    /** Get the identify bucket that a shard belongs to.
+     *
+     * @param shard The shard id.
+     * @return The bucket of the shard.
+     */
+    int bucket(int shard) const;
+
+    /** Get how many buckets there are, which is how many shards can start together. */
+    int max_concurrency() const;
+
+    /** Also wait for identifies reserved outside of this scheduler. Must be set before any identify is scheduled.
+     *
+     * @param remote The function to reserve identifies with.
+     */
+    void set_remote(RemoteDelay remote);
+
+    /** Run an identify as soon as the shard's bucket allows it.
+     *
+     * @param shard The shard that wants to identify.
+     * @param identify The callback that sends the identify. Runs on the timer wheel thread.
+     * @return The timer for the identify, which can be cancelled.
+     */
+    TimerWheel::TimerId schedule(int shard, TimerWheel::Callback identify);
+  };
+}
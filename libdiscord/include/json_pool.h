@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "common.h"
+
+namespace discord
+{
+  /** A document whose parse stack is also allocated from a memory pool. */
+  using PooledDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>, rapidjson::MemoryPoolAllocator<>>;
+
+  /** Reusable memory for parsing JSON payloads in place.
+   *
+   *  Both the DOM and the parser's stack are allocated out of buffers that are owned by the pool
+   *  and reused for every parse. If a payload needs more memory than the buffers hold, they are
+   *  grown after the parse so the next payload of that size fits without touching the heap.
+   */
+  class JsonPool
+  {
+    std::vector<char> m_value_buffer;
+    std::vector<char> m_stack_buffer;
+    std::unique_ptr<rapidjson::MemoryPoolAllocator<>> m_value_allocator;
+    std::unique_ptr<rapidjson::MemoryPoolAllocator<>> m_stack_allocator;
+    std::unique_ptr<PooledDocument> m_document;
+    size_t m_initial_size;
+
+    /** Recreates the allocators and document over the current buffers. */
+    void rebuild();
+
+    /** Releases the last document and grows the buffers if it did not fit in them. */
+    void prepare();
+  public:
+    /** The size that each buffer starts with. */
+    static const size_t INITIAL_BUFFER_SIZE;
+
+    /** The initial capacity of the parser's stack. */
+    static const size_t STACK_CAPACITY;
+
+    explicit JsonPool(size_t initial_size = INITIAL_BUFFER_SIZE);
+
+    JsonPool(const JsonPool&) = delete;
+    JsonPool& operator=(const JsonPool&) = delete;
+
+    /** Parses a mutable, null terminated buffer in place.
+     *
+     *  Strings in the returned document point into the given buffer, so the buffer must outlive it.
+     *  The document is only valid until the next call to parse_insitu.
+     *
+     * @param data The buffer to parse. Its contents are modified by the parser.
+     * @return The parsed document. Check HasParseError before using it.
+     */
+    PooledDocument& parse_insitu(char* data);
+
+    /** Shrinks the buffers back to their initial size if they have grown past a limit.
+     *  Invalidates the last document.
+     *
+     * @param limit The largest buffer size to keep.
+     */
+    void trim(size_t limit);
+
+    /** Builds a document from a generator of SAX events, such as a decoder for another format.
+     *
+     *  The document is only valid until the next call to parse_insitu or populate.
+     *
+     * @param generator A functor that sends SAX events to the document it is given.
+     * @return The populated document. It is left null if the generator failed.
+     */
+    template <typename Generator>
+    PooledDocument& populate(Generator& generator)
+    {
+      prepare();
+      return m_document->Populate(generator);
+    }
+  };
+}
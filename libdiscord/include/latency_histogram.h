@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace discord
+{
+  /** The number of buckets in a latency histogram. */
+  static const size_t LATENCY_BUCKET_COUNT = 10;
+
+  /** A summary of recent heartbeat round trips. */
+  struct LatencyStats
+  {
+    /** The most recent round trip. */
+    std::chrono::milliseconds last;
+    std::chrono::milliseconds average;
+    std::chrono::milliseconds p50;
+    std::chrono::milliseconds p99;
+    std::chrono::milliseconds max;
+
+    /** How many round trips the rest of the stats are made from. */
+    size_t samples;
+
+    /** Sample counts for each bucket, where bucket i holds samples up to LatencyHistogram::BUCKET_BOUNDS[i]. */
+    std::array<size_t, LATENCY_BUCKET_COUNT> histogram;
+
+    LatencyStats() : last(0), average(0), p50(0), p99(0), max(0), samples(0), histogram() {}
+  };
+
+  /** Keeps the last WINDOW latency samples along with a bucketed histogram of them.
+   *
+   *  The oldest sample is dropped from its bucket as each new one comes in, so recording is
+   *  constant time. Safe to record and read from different threads.
+   */
+  class LatencyHistogram
+  {
+  public:
+    /** How many samples are kept. */
+    static const size_t WINDOW = 128;
+
+    /** The upper bound in milliseconds of each bucket. The last bucket holds everything above the others. */
+    static const std::array<uint32_t, LATENCY_BUCKET_COUNT> BUCKET_BOUNDS;
+
+  private:
+    mutable std::mutex m_mutex;
+    std::array<uint32_t, WINDOW> m_samples;
+    std::array<size_t, LATENCY_BUCKET_COUNT> m_buckets;
+    size_t m_next;
+    size_t m_count;
+    uint32_t m_last;
+
+    /** Get the bucket that a sample belongs in. */
+    static size_t bucket(uint32_t sample);
+  public:
+    LatencyHistogram();
+
+    /** Add a sample, replacing the oldest one if the window is full.
+     *
+     * @param latency The round trip to add.
+     */
+    void record(std::chrono::milliseconds latency);
+
+    /** Get a summary of the samples in the window.
+     *
+     * @return The summary, with zero samples if nothing was recorded yet.
+     */
+    LatencyStats stats() const;
+  };
+}
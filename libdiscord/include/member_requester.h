@@ -0,0 +1,130 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pplx/pplxtasks.h>
+
+#include "common.h"
+#include "timer_wheel.h"
+
+namespace discord
+{
+  /** Loads guild members over the gateway with Request_Guild_Members, for guilds too large for
+   *  GUILD_CREATE to include every member.
+   *
+   *  Guilds are grouped by shard into batches of up to GUILDS_PER_BATCH, and each batch is sent
+   *  as one request with its own nonce. Every shard only has one batch in flight at a time, so
+   *  loading thousands of guilds never floods the gateway with chunks. A batch is finished once
+   *  every chunk of every guild in it has arrived, or when no chunk arrives for CHUNK_TIMEOUT.
+   */
+  class MemberRequester
+  {
+  public:
+    /** Sends a request for the members of guilds, which must all belong to the shard.
+     *
+     * @param shard The shard to send the request on.
+     * @param guild_ids The guilds to request the members of.
+     * @param nonce The nonce that the chunks of this request will carry.
+     */
+    using Sender = std::function<void(int shard, const std::vector<Snowflake>& guild_ids, const std::string& nonce)>;
+
+    /** The most guilds sent in a single request. */
+    static const size_t GUILDS_PER_BATCH;
+
+    /** How long a batch can go without receiving a chunk before it is given up on. */
+    static const std::chrono::milliseconds CHUNK_TIMEOUT;
+
+  private:
+    /** A call to request, which finishes when all of its batches do. */
+    struct Request
+    {
+      pplx::task_completion_event<uint32_t> done;
+      size_t batches_left;
+      uint32_t members;
+    };
+
+    /** A group of guilds on one shard that are requested together. */
+    struct Batch
+    {
+      std::shared_ptr<Request> request;
+      int shard;
+      std::vector<Snowflake> guild_ids;
+
+      //  Chunks still expected for each guild. Guilds are added when their first chunk arrives.
+      std::unordered_map<uint64_t, uint32_t> chunks_left;
+      size_t guilds_left;
+      TimerWheel::TimerId timeout;
+    };
+
+    TimerWheel& m_timers;
+    Sender m_sender;
+    std::mutex m_mutex;
+
+    int m_shards;
+    int m_first_shard;
+    int m_last_shard;
+    uint64_t m_next_nonce;
+    std::vector<std::deque<Batch>> m_waiting;
+    std::vector<std::string> m_in_flight;
+    std::unordered_map<std::string, Batch> m_batches;
+
+    /** Sends the next waiting batch of a shard if it has nothing in flight. The mutex must be held.
+     *
+     * @param shard The shard to send on.
+     */
+    void send_next(int shard);
+
+    /** Restarts the timeout of a batch that is in flight. The mutex must be held.
+     *
+     * @param nonce The nonce of the batch.
+     * @param batch The batch.
+     */
+    void reset_timeout(const std::string& nonce, Batch& batch);
+
+    /** Finishes a batch, then sends the next one of its shard. The mutex must be held.
+     *
+     * @param nonce The nonce of the batch.
+     */
+    void finish(const std::string& nonce);
+  public:
+    explicit MemberRequester(TimerWheel& timers);
+
+    /** Fails every request that hasn't finished. */
+    ~MemberRequester();
+
+    MemberRequester(const MemberRequester&) = delete;
+    MemberRequester& operator=(const MemberRequester&) = delete;
+
+    /** Set how requests are sent. Must be called before request.
+     *
+     * @param shards The total amount of shards.
+     * @param first_shard The first shard that this process runs.
+     * @param last_shard One past the last shard that this process runs.
+     * @param sender The function that sends a request over a shard.
+     */
+    void set_sender(int shards, int first_shard, int last_shard, Sender sender);
+
+    /** Request every member of a set of guilds.
+     *
+     *  Guilds on shards that this process doesn't run are skipped.
+     *
+     * @param guild_ids The guilds to load the members of.
+     * @return A task that finishes with the amount of members received once every guild is done.
+     */
+    pplx::task<uint32_t> request(const std::vector<Snowflake>& guild_ids);
+
+    /** Handle a GUILD_MEMBERS_CHUNK, after its members have been cached.
+     *
+     * @param guild_id The guild the chunk is for.
+     * @param nonce The nonce of the chunk.
+     * @param chunk_count How many chunks the guild's response has.
+     * @param members How many members were in the chunk.
+     */
+    void on_chunk(Snowflake guild_id, const std::string& nonce, uint32_t chunk_count, uint32_t members);
+  };
+}
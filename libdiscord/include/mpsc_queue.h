@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace discord
+{
+  /** An unbounded lock-free queue for many producers and a single consumer.
+   *
+   *  Producers link a node onto the head with one atomic exchange, and the consumer follows the
+   *  links from the tail. This is Dmitry Vyukov's intrusive MPSC queue with a stub node, so a push
+   *  never waits on another thread.
+   *
+   *  Any thread may call push. Only one thread at a time may call front, pop and empty.
+   */
+  template <typename T>
+  class MpscQueue
+  {
+    struct Node
+    {
+      std::atomic<Node*> next;
+      T value;
+
+      Node() : next(nullptr) {}
+      explicit Node(T&& value) : next(nullptr), value(std::move(value)) {}
+    };
+
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+  public:
+    MpscQueue()
+    {
+      auto stub = new Node();
+      m_head.store(stub);
+      m_tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+      while (m_tail)
+      {
+        auto next = m_tail->next.load();
+        delete m_tail;
+        m_tail = next;
+      }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /** Add a value to the queue. Safe to call from any thread.
+     *
+     * @param value The value to add.
+     */
+    void push(T value)
+    {
+      auto node = new Node(std::move(value));
+      auto prev = m_head.exchange(node, std::memory_order_acq_rel);
+      prev->next.store(node, std::memory_order_release);
+    }
+
+    /** Get the oldest value without removing it. Consumer only.
+     *
+     *  A push that is still in progress may not be visible yet.
+     *
+     * @return The oldest value, or nullptr if the queue is empty.
+     */
+    T* front()
+    {
+      auto next = m_tail->next.load(std::memory_order_acquire);
+      return next ? &next->value : nullptr;
+    }
+
+    /** Remove the oldest value. Consumer only, and front must have returned a value. */
+    void pop()
+    {
+      auto next = m_tail->next.load(std::memory_order_acquire);
+
+      //  The node holding the popped value becomes the new stub.
+      next->value = T();
+      delete m_tail;
+      m_tail = next;
+    }
+
+    /** Check if the queue has nothing to consume. Consumer only. */
+    bool empty()
+    {
+      return front() == nullptr;
+    }
+  };
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <pplx/pplxtasks.h>
+
+#include "snowflake.h"
+
+namespace discord
+{
+  /** Walks an endpoint that is paged by id, such as the message history of a channel, one page at a time.
+   *
+   *  Pages are requested ahead of being asked for, so the next page is already on its way while the
+   *  current one is processed. At most read_ahead pages are held that haven't been asked for, however
+   *  long the walk is. Copies of a paginator share the same walk.
+   */
+  template <typename T>
+  class Paginator
+  {
+  public:
+    /** Requests the page that comes after a cursor. */
+    using Fetch = std::function<pplx::task<std::vector<T>>(Snowflake cursor)>;
+
+    /** Gets the cursor of the page that comes after a page. */
+    using Advance = std::function<Snowflake(const std::vector<T>& page)>;
+
+  private:
+    struct State
+    {
+      std::mutex mutex;
+      Fetch fetch;
+      Advance advance;
+      Snowflake cursor;
+      size_t page_size;
+      size_t read_ahead;
+
+      //  Pages that arrived before they were asked for.
+      std::deque<std::vector<T>> pages;
+
+      //  Calls to next that are waiting for a page.
+      std::deque<pplx::task_completion_event<std::vector<T>>> waiting;
+
+      std::exception_ptr error;
+      bool fetching;
+      bool finished;
+    };
+
+    std::shared_ptr<State> m_state;
+
+    /** Hands out pages to waiting calls to next. The mutex must be held, and the returned actions run once it is released.
+     *
+     * @param state The walk.
+     * @param actions Filled with actions that complete the waiting calls.
+     */
+    static void settle(State& state, std::vector<std::function<void()>>& actions)
+    {
+      while (!state.waiting.empty() && (!state.pages.empty() || state.finished))
+      {
+        auto event = state.waiting.front();
+        state.waiting.pop_front();
+
+        if (!state.pages.empty())
+        {
+          auto page = std::make_shared<std::vector<T>>(std::move(state.pages.front()));
+          state.pages.pop_front();
+          actions.push_back([event, page]() { event.set(std::move(*page)); });
+        }
+        else if (state.error)
+        {
+          auto error = state.error;
+          state.error = nullptr;
+          actions.push_back([event, error]() { event.set_exception(error); });
+        }
+        else
+        {
+          actions.push_back([event]() { event.set(std::vector<T>()); });
+        }
+      }
+    }
+
+    /** Requests the next page if there is room for it and none is in flight.
+     *
+     * @param state The walk.
+     */
+    static void fill(std::shared_ptr<State> state)
+    {
+      Snowflake cursor;
+
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        if (state->fetching || state->finished || (state->pages.size() >= state->read_ahead && state->waiting.empty()))
+        {
+          return;
+        }
+
+        state->fetching = true;
+        cursor = state->cursor;
+      }
+
+      pplx::task<std::vector<T>> page;
+
+      try
+      {
+        page = state->fetch(cursor);
+      }
+      catch (...)
+      {
+        page = pplx::task_from_exception<std::vector<T>>(std::current_exception());
+      }
+
+      page.then([state, cursor](pplx::task<std::vector<T>> result)
+      {
+        std::vector<std::function<void()>> actions;
+
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          state->fetching = false;
+
+          try
+          {
+            auto items = result.get();
+
+            //  Stopped while the page was in flight.
+            if (state->finished)
+            {
+              return;
+            }
+
+            auto next = items.empty() ? cursor : state->advance(items);
+
+            //  A page that doesn't move the cursor comes from an endpoint that ignores it, so the first page was everything.
+            if (items.empty() || next == cursor)
+            {
+              state->finished = true;
+            }
+            else
+            {
+              //  A short page is the last one.
+              state->finished = items.size() < state->page_size;
+              state->cursor = next;
+              state->pages.push_back(std::move(items));
+            }
+          }
+          catch (...)
+          {
+            state->error = std::current_exception();
+            state->finished = true;
+          }
+
+          settle(*state, actions);
+        }
+
+        for (auto& action : actions)
+        {
+          action();
+        }
+
+        fill(state);
+      });
+    }
+  public:
+    /** Start a walk.
+     *
+     * @param fetch Requests the page after a cursor.
+     * @param advance Gets the cursor of the page after a page.
+     * @param start The cursor of the first page.
+     * @param page_size How many items a full page has. A page with fewer ends the walk.
+     * @param read_ahead How many pages to request before they are asked for.
+     */
+    Paginator(Fetch fetch, Advance advance, Snowflake start, size_t page_size, size_t read_ahead = 1) : m_state(std::make_shared<State>())
+    {
+      m_state->fetch = fetch;
+      m_state->advance = advance;
+      m_state->cursor = start;
+      m_state->page_size = page_size;
+      m_state->read_ahead = read_ahead;
+      m_state->fetching = false;
+      m_state->finished = false;
+
+      fill(m_state);
+    }
+
+    /** Get the next page.
+     *
+     * @return The next page, or an empty page once the walk is over.
+     */
+    pplx::task<std::vector<T>> next()
+    {
+      pplx::task_completion_event<std::vector<T>> event;
+      std::vector<std::function<void()>> actions;
+
+      {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->waiting.push_back(event);
+        settle(*m_state, actions);
+      }
+
+      for (auto& action : actions)
+      {
+        action();
+      }
+
+      fill(m_state);
+      return pplx::create_task(event);
+    }
+
+    /** Call a function on every item that is left, one page at a time.
+     *
+     * @param callback Called on each item. Returning false stops the walk.
+     * @return A task that finishes once the walk is over or stopped.
+     */
+    pplx::task<void> for_each(std::function<bool(T&)> callback)
+    {
+      auto self = *this;
+
+      return next().then([self, callback](std::vector<T> page) mutable -> pplx::task<void>
+      {
+        if (page.empty())
+        {
+          return pplx::task_from_result();
+        }
+
+        for (auto& item : page)
+        {
+          if (!callback(item))
+          {
+            self.stop();
+            return pplx::task_from_result();
+          }
+        }
+
+        return self.for_each(callback);
+      });
+    }
+
+    /** Stop the walk and drop the pages that were read ahead. Calls to next get an empty page from now on. */
+    void stop()
+    {
+      std::vector<std::function<void()>> actions;
+
+      {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->finished = true;
+        m_state->pages.clear();
+        m_state->error = nullptr;
+        settle(*m_state, actions);
+      }
+
+      for (auto& action : actions)
+      {
+        action();
+      }
+    }
+  };
+}
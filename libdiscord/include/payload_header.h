@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace discord
+{
+  /** The fields of a gateway payload that are needed to decide whether it is worth parsing. */
+  struct PayloadHeader
+  {
+    /** The opcode, or -1 if it wasn't found. */
+    int op;
+
+    /** The sequence, or -1 if it wasn't found or was null. */
+    int64_t seq;
+
+    /** The event name, pointing into the payload. Not null terminated. */
+    const char* event;
+    size_t event_length;
+
+    /** The "guild_id" of the data object, or 0 if there isn't one. */
+    uint64_t guild_id;
+
+    /** The "id" of the data object, or 0 if there isn't one. Guild events carry their guild id here. */
+    uint64_t id;
+
+    PayloadHeader() : op(-1), seq(-1), event(nullptr), event_length(0), guild_id(0), id(0) {}
+  };
+
+  /** Scans a JSON payload for its header without building a document.
+   *
+   *  Only the top level and the first level of "d" are looked at. Everything else is skipped by
+   *  matching brackets and quotes, which is much cheaper than a full parse. The scan stops as soon
+   *  as the fields that are needed are found, so the rest is only ever checked by the real parse.
+   *
+   * @param data The payload text.
+   * @param size The size of the payload text.
+   * @param header Filled with the fields that were found.
+   * @param need_guild Whether to keep looking in "d" for the guild of a dispatch.
+   * @return False if the payload is malformed, in which case it should be fully parsed instead.
+   */
+  bool scan_json_header(const char* data, size_t size, PayloadHeader& header, bool need_guild = true);
+
+  /** Scans an ETF payload for its header without decoding it. Stops once the fields that are needed are found.
+   *
+   * @param data The payload data.
+   * @param size The size of the payload data.
+   * @param header Filled with the fields that were found.
+   * @param need_guild Whether to keep looking in "d" for the guild of a dispatch.
+   * @return False if the payload is malformed, in which case it should be fully decoded instead.
+   */
+  bool scan_etf_header(const char* data, size_t size, PayloadHeader& header, bool need_guild = true);
+}
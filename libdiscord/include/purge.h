@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include "snowflake.h"
+
+namespace discord
+{
+  class Message;
+
+  /** Which messages a purge deletes. */
+  struct PurgeOptions
+  {
+    /** The most messages a bulk delete can take. */
+    static const size_t BULK_DELETE_LIMIT;
+
+    /** Messages older than this can't be bulk deleted, and are deleted one at a time instead. Kept a little
+     *  short of Discord's two weeks, so a message can't age past it while it waits for the rate limit.
+     */
+    static const std::chrono::milliseconds BULK_DELETE_MAX_AGE;
+
+    /** The most messages to delete, or 0 for no limit. */
+    size_t limit;
+
+    /** Only delete messages older than this one, or 0 to start from the newest message. Use Snowflake::from_time to purge by time. */
+    Snowflake before;
+
+    /** Only delete messages newer than this one, or 0 to go back to the start of the channel. */
+    Snowflake after;
+
+    /** Decides whether a message is deleted, such as by its author or content. If empty, every message is. */
+    std::function<bool(const Message&)> filter;
+
+    /** How many pages of messages to fetch ahead while the current page is deleted. */
+    size_t read_ahead;
+
+    PurgeOptions();
+  };
+
+  /** What a purge did. */
+  struct PurgeResult
+  {
+    /** How many messages were looked at. */
+    size_t scanned;
+
+    /** How many messages passed the filter. */
+    size_t matched;
+
+    /** How many messages were deleted. Matched messages that weren't deleted failed to. */
+    size_t deleted;
+
+    PurgeResult() : scanned(0), matched(0), deleted(0)
+    {
+    }
+  };
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "api.h"
+#include "common.h"
+#include "timer_wheel.h"
+
+namespace discord
+{
+  /** The rate limit headers of a REST response. */
+  struct RateLimitInfo
+  {
+    /** The bucket the route belongs to, or empty if the response didn't say. */
+    std::string bucket;
+
+    /** How many requests the bucket allows per window, or -1 if unknown. */
+    int32_t limit;
+
+    /** How many requests are left in the current window, or -1 if unknown. */
+    int32_t remaining;
+
+    /** How long until the window resets. */
+    std::chrono::milliseconds reset_after;
+
+    /** How long to wait before retrying, if the request was rate limited. */
+    std::chrono::milliseconds retry_after;
+
+    /** Whether the rate limit that was hit applies to every route. */
+    bool global;
+
+    RateLimitInfo() : limit(-1), remaining(-1), reset_after(0), retry_after(0), global(false)
+    {
+    }
+  };
+
+  /** Holds REST requests back until Discord's rate limits allow them, without blocking any thread.
+   *
+   *  Routes start out in a bucket of their own that lets one request through at a time. Once a
+   *  response names the route's X-RateLimit-Bucket, the route moves to that bucket, which every route
+   *  sharing the bucket's limit also uses. Requests a bucket can't send yet wait in its queue and are
+   *  released by a timer when the window resets, or when the global limit lifts.
+   *
+   *  The route table is split into SHARDS shards by major parameter, each with its own lock, so
+   *  requests on different channels and guilds rarely contend. Buckets are per major parameter, so a
+   *  bucket never spans shards. Buckets that stay idle for IDLE_TIMEOUT are dropped.
+   */
+  class RateLimiter
+  {
+  public:
+    /** Sends a request. Must not block, it can run on the timer thread. */
+    using Start = std::function<void()>;
+
+    /** How many shards the route table is split into. */
+    static const size_t SHARDS;
+
+    /** How long a bucket has to go unused before it is dropped. */
+    static const std::chrono::milliseconds IDLE_TIMEOUT;
+
+  private:
+    struct Bucket
+    {
+      //  The X-RateLimit-Bucket of the bucket, or empty until the route's bucket is known.
+      std::string name;
+      int32_t limit;
+      int32_t remaining;
+      std::chrono::steady_clock::time_point reset;
+
+      //  The longest reset seen, used as the next window when a window ends before a response says so.
+      std::chrono::milliseconds window;
+      size_t in_flight;
+      std::deque<Start> waiting;
+      TimerWheel::TimerId timer;
+      std::chrono::steady_clock::time_point last_used;
+    };
+
+    /** An API key and the id of its major parameter. */
+    struct Route
+    {
+      APIKey key;
+      uint64_t major;
+
+      bool operator==(const Route& other) const
+      {
+        return key == other.key && major == other.major;
+      }
+    };
+
+    struct RouteHash
+    {
+      size_t operator()(const Route& route) const
+      {
+        return std::hash<uint64_t>()(route.major * 31 + route.key);
+      }
+    };
+
+    /** A part of the route table, along with the buckets of its routes. */
+    struct Shard
+    {
+      std::mutex mutex;
+      std::unordered_map<Route, std::shared_ptr<Bucket>, RouteHash> routes;
+
+      //  Known buckets, keyed by bucket hash and major parameter.
+      std::unordered_map<std::string, std::shared_ptr<Bucket>> buckets;
+    };
+
+    TimerWheel& m_timers;
+    std::unique_ptr<Shard[]> m_shards;
+    TimerWheel::TimerId m_sweep_timer;
+
+    //  Read without the lock by every release. The lock only guards arming the timer.
+    std::atomic<std::chrono::steady_clock::rep> m_global_reset;
+    std::mutex m_global_mutex;
+    TimerWheel::TimerId m_global_timer;
+
+    //  Set once the limiter is being destroyed, so no more timers are armed.
+    std::atomic<bool> m_stopping;
+
+    /** Gets the shard that holds the routes of a major parameter. */
+    size_t shard_of(uint64_t major) const;
+
+    /** Creates a bucket that nothing is known about yet. */
+    static std::shared_ptr<Bucket> make_bucket(const std::string& name);
+
+    /** Finds the bucket a route uses, creating it if needed. The shard's mutex must be held. */
+    std::shared_ptr<Bucket>& find_route(Shard& shard, const Route& route);
+
+    /** Releases as many waiting requests of a bucket as its limit allows, and arms its timer if
+     *  some have to keep waiting. The mutex of the bucket's shard must be held.
+     *
+     * @param shard The index of the bucket's shard.
+     * @param bucket The bucket.
+     * @param ready Filled with the requests that may be sent, to be started once the mutex is released.
+     */
+    void release(size_t shard, const std::shared_ptr<Bucket>& bucket, std::vector<Start>& ready);
+
+    /** Releases what it can from one bucket, then starts the requests it released. */
+    void pump(size_t shard, std::weak_ptr<Bucket> bucket);
+
+    /** Releases what it can from every bucket, after the global limit lifts. */
+    void pump_all();
+
+    /** Drops the routes and buckets that have been idle for IDLE_TIMEOUT. */
+    void sweep();
+  public:
+    explicit RateLimiter(TimerWheel& timers);
+
+    /** Cancels the timers of every bucket and waits for any that are running. Requests that are still waiting are never started. */
+    ~RateLimiter();
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    /** Queue a request on its route. It is started right away if the route's bucket allows it.
+     *
+     * @param key The API key of the route.
+     * @param major The major parameter of the route.
+     * @param start Sends the request. Every request must be followed by a call to complete.
+     */
+    void acquire(APIKey key, Snowflake major, Start start);
+
+    /** Record the rate limit headers of a response, and release the requests that they allow.
+     *
+     * @param key The API key of the route.
+     * @param major The major parameter of the route.
+     * @param info The headers of the response, or a default RateLimitInfo if there was no response.
+     */
+    void complete(APIKey key, Snowflake major, const RateLimitInfo& info);
+
+    /** Get how many requests a route's bucket allows per window.
+     *
+     * @param key The API key of the route.
+     * @param major The major parameter of the route.
+     * @return The limit, or -1 if the route hasn't had a response that said.
+     */
+    int32_t limit(APIKey key, Snowflake major);
+  };
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "api.h"
+#include "common.h"
+
+namespace discord
+{
+  /** Keeps the responses of selected GET routes for a while, so repeated calls don't touch the network.
+   *
+   *  Only routes with a TTL are cached. Entries expire after their route's TTL, are evicted least
+   *  recently used first once there are more than the maximum, and are invalidated when a gateway
+   *  event says the data changed. A response that was in flight while its path or route was
+   *  invalidated is not stored, so a stale response can never overwrite an invalidation.
+   */
+  class ResponseCache
+  {
+  public:
+    /** The most responses kept by default. */
+    static const size_t DEFAULT_MAX_ENTRIES;
+
+    /** The most invalidations remembered. Once there are more, they are forgotten and every response
+     *  in flight at the time is not stored.
+     */
+    static const size_t MAX_INVALIDATIONS;
+
+  private:
+    struct Entry
+    {
+      std::shared_ptr<APIResponse> response;
+      std::chrono::steady_clock::time_point expires;
+      APIKey key;
+      uint64_t major;
+      std::list<std::string>::iterator order;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<int, std::chrono::milliseconds> m_ttls;
+    std::unordered_map<std::string, Entry> m_entries;
+
+    //  The paths cached for each route, so a route can be invalidated without a scan.
+    std::map<std::pair<int, uint64_t>, std::unordered_set<std::string>> m_routes;
+
+    //  Paths from most to least recently used.
+    std::list<std::string> m_order;
+    size_t m_max_entries;
+
+    //  Counts invalidations. Each path and route remembers the count from when it was last
+    //  invalidated, and a response is only stored if neither changed since its request was sent.
+    //  Forgotten invalidations are covered by m_floor, which requests must not be older than.
+    uint64_t m_generation;
+    uint64_t m_floor;
+    std::unordered_map<std::string, uint64_t> m_path_invalidations;
+    std::map<std::pair<int, uint64_t>, uint64_t> m_route_invalidations;
+
+    /** Removes an entry. The mutex must be held. */
+    void erase(std::unordered_map<std::string, Entry>::iterator entry);
+
+    /** Forgets every invalidation once there are more than MAX_INVALIDATIONS. The mutex must be held. */
+    void forget_invalidations();
+  public:
+    ResponseCache();
+
+    /** Set how long responses of a route are kept.
+     *
+     * @param key The route.
+     * @param ttl How long to keep its responses, or zero to stop caching it.
+     */
+    void set_ttl(APIKey key, std::chrono::milliseconds ttl);
+
+    /** Set the most responses to keep.
+     *
+     * @param max_entries The most responses to keep, or zero to cache nothing.
+     */
+    void set_max_entries(size_t max_entries);
+
+    /** Check whether a route is cached.
+     *
+     * @param key The route.
+     * @return True if the route has a TTL.
+     */
+    bool cacheable(APIKey key) const;
+
+    /** Get the current generation, which changes whenever anything is invalidated.
+     *  Taken before a request is sent and passed to store once it finishes, which compares it to
+     *  the invalidations of that request's path and route only.
+     *
+     * @return The current generation.
+     */
+    uint64_t generation() const;
+
+    /** Find a cached response.
+     *
+     * @param path The path and query of the request.
+     * @return The response, or nullptr if it isn't cached or has expired.
+     */
+    std::shared_ptr<APIResponse> find(const std::string& path);
+
+    /** Store a response.
+     *
+     * @param key The route of the request.
+     * @param major The major parameter of the request.
+     * @param path The path and query of the request.
+     * @param response The response.
+     * @param generation The generation from when the request was sent. Nothing is stored if the path or route was invalidated since.
+     */
+    void store(APIKey key, Snowflake major, const std::string& path, std::shared_ptr<APIResponse> response, uint64_t generation);
+
+    /** Drop every cached response of a route.
+     *
+     * @param key The route.
+     * @param major The major parameter of the route.
+     */
+    void invalidate(APIKey key, Snowflake major);
+
+    /** Drop the cached response of a single path.
+     *
+     * @param path The path and query of the request.
+     */
+    void invalidate(const std::string& path);
+  };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace discord
+{
+  /** Keeps a shard's session id and sequence in a small memory-mapped file so it survives restarts.
+   *
+   *  Writes go straight to mapped memory, so saving the sequence on every dispatch is a single
+   *  store. The operating system writes the page back to disk, even if the process crashes.
+   */
+  class SessionStore
+  {
+    struct Record;
+
+    Record* m_record;
+
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_fd;
+#endif
+
+    /** Get the current unix time in milliseconds. */
+    static int64_t now();
+  public:
+    /** Sessions that haven't heartbeated for longer than this are not worth trying to resume. */
+    static const int64_t MAX_SESSION_AGE;
+
+    /** The longest session id that can be stored. */
+    static const size_t SESSION_ID_CAPACITY;
+
+    /** Open or create the session file for a shard.
+     *
+     *  Throws a DiscordException if the file can't be opened or mapped.
+     *
+     * @param path The file to keep the session in.
+     * @param shard The shard the session belongs to.
+     * @param total_shards The total amount of shards the session was made with.
+     */
+    SessionStore(const std::string& path, int shard, int total_shards);
+    ~SessionStore();
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    /** Read a stored session that can still be resumed.
+     *
+     * @param session_id Set to the stored session id.
+     * @param seq Set to the last stored sequence.
+     * @return True if a session was found for the same shard setup and it is recent enough to resume.
+     */
+    bool load(std::string& session_id, uint32_t& seq) const;
+
+    /** Store a new session.
+     *
+     * @param session_id The session id from READY.
+     * @param seq The sequence of the READY payload.
+     */
+    void save_session(const std::string& session_id, uint32_t seq);
+
+    /** Store the latest sequence. Cheap enough to call for every dispatch.
+     *
+     * @param seq The sequence to store.
+     */
+    void save_seq(uint32_t seq);
+
+    /** Mark the session as still alive. */
+    void touch();
+
+    /** Forget the stored session, so the next start will identify. */
+    void clear();
+  };
+}
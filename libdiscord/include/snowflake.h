@@ -1,14 +1,21 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <stdexcept>
 #include <string>
 
+#include <rapidjson/document.h>
+
 namespace discord
 {
   class Snowflake
   {
     uint64_t m_id;
   public:
+    /** The time snowflakes count from, the first second of 2015, in milliseconds since the Unix epoch. */
+    static const uint64_t EPOCH = 1420070400000;
+
     Snowflake() : m_id(0) {};
     Snowflake(uint64_t id) : m_id(id) {};
 
@@ -17,6 +24,47 @@ namespace discord
       m_id = std::stoull(s);
     }
 
+    /** Reads a snowflake from a JSON value. JSON sends snowflakes as strings, but ETF sends them as integers.
+     *
+     * @param value The value holding the snowflake.
+     * @throw std::invalid_argument If the value is not an integer or a string of digits.
+     * @throw std::out_of_range If the value does not fit in 64 bits.
+     */
+    explicit Snowflake(const rapidjson::Value& value) : m_id(0)
+    {
+      if (value.IsUint64())
+      {
+        m_id = value.GetUint64();
+      }
+      else if (value.IsString() && value.GetStringLength() != 0)
+      {
+        //  Parse the digits directly rather than building a std::string for std::stoull.
+        auto str = value.GetString();
+        auto length = value.GetStringLength();
+
+        for (rapidjson::SizeType i = 0; i < length; ++i)
+        {
+          if (str[i] < '0' || str[i] > '9')
+          {
+            throw std::invalid_argument("Snowflake has a character that is not a digit: " + std::string(str, length));
+          }
+
+          auto digit = static_cast<uint64_t>(str[i] - '0');
+
+          if (m_id > (UINT64_MAX - digit) / 10)
+          {
+            throw std::out_of_range("Snowflake does not fit in 64 bits: " + std::string(str, length));
+          }
+
+          m_id = m_id * 10 + digit;
+        }
+      }
+      else
+      {
+        throw std::invalid_argument("Snowflake is not a string of digits or an integer.");
+      }
+    }
+
     bool operator==(const Snowflake& rhs) const
     {
       return m_id == rhs.m_id;
@@ -46,5 +94,25 @@ namespace discord
     {
       return m_id;
     }
+
+    /** Get the time this snowflake was created at.
+     *
+     * @return The time that is encoded in the snowflake.
+     */
+    std::chrono::system_clock::time_point time() const
+    {
+      return std::chrono::system_clock::time_point(std::chrono::milliseconds((m_id >> 22) + EPOCH));
+    }
+
+    /** Make the smallest snowflake that could have been created at a time, to search by time with.
+     *
+     * @param time The time to make a snowflake for.
+     * @return The snowflake, or zero if the time is before snowflakes began.
+     */
+    static Snowflake from_time(std::chrono::system_clock::time_point time)
+    {
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+      return ms <= static_cast<int64_t>(EPOCH) ? Snowflake() : Snowflake(static_cast<uint64_t>(ms - EPOCH) << 22);
+    }
   };
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace discord
+{
+  /** A hashed timer wheel that runs every timer from a single thread.
+   *
+   *  Timers are placed in a slot of the wheel based on when they expire, along with how many full
+   *  turns of the wheel they must wait. Every tick the wheel moves to the next slot and fires the
+   *  timers there that have no turns left. Scheduling and cancelling are constant time.
+   *
+   *  Callbacks run on the wheel's thread, so they should be short and must not block. Once cancel
+   *  returns the timer's callback is not running and never will, so its captures can be freed.
+   */
+  class TimerWheel
+  {
+  public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    /** The resolution of the wheel. */
+    static const std::chrono::milliseconds TICK;
+
+    /** The amount of slots in the wheel. */
+    static const size_t SLOTS;
+
+    /** An id that never refers to a timer. */
+    static const TimerId INVALID_TIMER;
+
+  private:
+    struct Timer
+    {
+      uint64_t rounds;
+      std::chrono::milliseconds interval;
+      Callback callback;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_callback_done;
+    std::thread m_thread;
+    bool m_running;
+
+    std::vector<std::vector<TimerId>> m_slots;
+    std::unordered_map<TimerId, Timer> m_timers;
+    size_t m_cursor;
+    TimerId m_next_id;
+
+    //  Timers that fired and are waiting for their callback to run, and the one that is running.
+    std::unordered_set<TimerId> m_due;
+    TimerId m_firing;
+
+    /** Places a timer in the wheel. The mutex must be held.
+     *
+     * @param id The timer to place.
+     * @param delay How long from now the timer should fire.
+     */
+    void insert(TimerId id, std::chrono::milliseconds delay);
+
+    /** Moves the wheel forward by one slot. The mutex must be held.
+     *
+     * @param due Filled with every timer that fired along with its callback.
+     */
+    void advance(std::vector<std::pair<TimerId, Callback>>& due);
+
+    /** Runs the wheel until stopped. */
+    void run();
+
+    /** Adds a timer and starts the wheel's thread if it isn't running yet.
+     *
+     * @param delay How long from now the timer should first fire.
+     * @param interval How often the timer repeats, or zero to fire once.
+     * @param callback The callback to run.
+     * @return The id of the new timer.
+     */
+    TimerId add(std::chrono::milliseconds delay, std::chrono::milliseconds interval, Callback callback);
+  public:
+    TimerWheel();
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /** Runs a callback once after a delay.
+     *
+     * @param delay How long to wait before running the callback.
+     * @param callback The callback to run.
+     * @return An id that can be used to cancel the timer.
+     */
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+
+    /** Runs a callback repeatedly until it is cancelled.
+     *
+     * @param interval How long to wait between each run, starting from now.
+     * @param callback The callback to run.
+     * @return An id that can be used to cancel the timer.
+     */
+    TimerId schedule_every(std::chrono::milliseconds interval, Callback callback);
+
+    /** Cancels a timer. Does nothing if the timer already fired or doesn't exist.
+     *  If the timer's callback is running, waits for it to finish unless called from that callback,
+     *  so this must not be called while holding a lock that the callback takes.
+     *
+     * @param id The timer to cancel.
+     */
+    void cancel(TimerId id);
+
+    /** Cancels a timer without waiting for its callback if it is already running. For use under a
+     *  lock that the callback takes, when the callback copes with running after the cancel.
+     *
+     * @param id The timer to cancel.
+     */
+    void cancel_pending(TimerId id);
+
+    /** Stops the wheel's thread and drops every timer. Waits for running callbacks to finish. */
+    void stop();
+  };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace discord
+{
+  /** A token bucket that refills continuously.
+   *
+   *  Tokens refill at a steady rate up to the capacity of the bucket, so short bursts are allowed
+   *  while the long term rate stays bounded. Not thread safe, the owner must serialize access.
+   */
+  class TokenBucket
+  {
+    double m_capacity;
+    double m_tokens;
+    double m_tokens_per_ms;
+    std::chrono::steady_clock::time_point m_last_refill;
+
+    /** Add the tokens that have accumulated since the last refill. */
+    void refill();
+  public:
+    /** Create a full bucket.
+     *
+     * @param capacity The most tokens the bucket can hold.
+     * @param period How long it takes to refill an empty bucket.
+     */
+    TokenBucket(uint32_t capacity, std::chrono::milliseconds period);
+
+    /** Take a token if one is available.
+     *
+     * @param reserve How many tokens must be left in the bucket after this one is taken.
+     * @return Zero if a token was taken, otherwise how long until one will be available.
+     */
+    std::chrono::milliseconds try_acquire(uint32_t reserve = 0);
+  };
+}
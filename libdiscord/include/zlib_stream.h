@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//  Forward declaration so zlib.h does not leak into library users.
+struct z_stream_s;
+
+namespace discord
+{
+  /** A long-lived inflate context for gateway payloads.
+   *
+   *  In zlib-stream mode every frame from a connection belongs to one shared zlib stream, so
+   *  the inflate state must persist between frames. A payload is only complete once a frame
+   *  ends in the Z_SYNC_FLUSH suffix, so partial frames are buffered until it arrives.
+   *  The output buffer is kept between payloads and only grows, so steady state decompression
+   *  does not allocate.
+   */
+  class ZlibStream
+  {
+    std::unique_ptr<z_stream_s> m_stream;
+    std::vector<char> m_input;
+    std::vector<char> m_output;
+    size_t m_output_size;
+
+    /** Inflates a full buffer into the output buffer.
+     *
+     * @param data The compressed data to inflate.
+     * @param size The size of the compressed data.
+     * @param flush The zlib flush mode to use.
+     * @return The last return value from zlib's inflate.
+     */
+    int inflate_buffer(const char* data, size_t size, int flush);
+  public:
+    /** The suffix that Discord appends to the end of every complete zlib-stream payload. */
+    static const uint32_t SYNC_FLUSH_SUFFIX;
+
+    /** The size that the output buffer starts with. */
+    static const size_t INITIAL_BUFFER_SIZE;
+
+    ZlibStream();
+    ~ZlibStream();
+
+    ZlibStream(const ZlibStream&) = delete;
+    ZlibStream& operator=(const ZlibStream&) = delete;
+
+    /** Resets the inflate state. Must be called whenever a new connection is made. */
+    void reset();
+
+    /** Feeds a frame from a zlib-stream connection.
+     *
+     * @param data The compressed frame data.
+     * @param size The size of the frame.
+     * @return True if a full payload is now available through data() and size().
+     * @throw DiscordException on decompression errors. The stream must be reset afterwards.
+     */
+    bool push(const char* data, size_t size);
+
+    /** Inflates a self-contained payload sent with the per-payload "compress" option.
+     *
+     * @param data The compressed payload.
+     * @param size The size of the payload.
+     * @throw DiscordException on decompression errors.
+     */
+    void inflate_payload(const char* data, size_t size);
+
+    /** Get the last payload that was inflated. The buffer is always null terminated.
+     *
+     * @return A pointer to the inflated data. Only valid until the next call to push or inflate_payload.
+     */
+    char* data();
+
+    /** Get the size of the last payload that was inflated, not including the null terminator.
+     *
+     * @return The size of the inflated data.
+     */
+    size_t size() const;
+  };
+}
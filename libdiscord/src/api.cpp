@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "api.h"
 #include "common.h"
 #include "connection_state.h"
@@ -5,26 +7,86 @@
 
 namespace discord
 {
+  const size_t APIResponse::MIN_CHUNK_SIZE = 1024;
+
+  APIResponse::APIResponse() : status_code(0)
+  {
+  }
+
+  APIResponse::APIResponse(uint16_t status_code, std::string body)
+    : m_body(std::make_unique<std::string>(std::move(body))),
+      m_allocator(std::make_unique<rapidjson::MemoryPoolAllocator<>>(std::max(m_body->size(), MIN_CHUNK_SIZE))),
+      data(m_allocator.get()),
+      status_code(status_code)
+  {
+    //  The DOM of a parse in place is smaller than its text, so a single chunk usually holds all of it.
+    if (!m_body->empty())
+    {
+      data.ParseInsitu(&(*m_body)[0]);
+    }
+  }
+
+  APIResponse& APIResponse::operator=(APIResponse&& other)
+  {
+    //  Replace the document first, so the old one is released before the memory it lives in.
+    data = std::move(other.data);
+    m_allocator = std::move(other.m_allocator);
+    m_body = std::move(other.m_body);
+    status_code = other.status_code;
+    return *this;
+  }
+
   namespace api 
   {
-    std::string get_wss_url(ConnectionState& conn, int* shards)
+    GatewayInfo get_gateway_bot(ConnectionState& conn)
     {
       auto response = conn.request(Gateway_Bot, 0, Method::GET, "gateway/bot").get();
 
-      if (response.status_code != 200)
+      if (response->status_code != 200)
       {
         throw DiscordException("Could not connect to gateway endpoint.");
       }
 
-      auto found = response.data.FindMember("shards");
+      GatewayInfo info;
+      info.url = response->data["url"].GetString();
+
+      auto found = response->data.FindMember("shards");
+
+      if (found != response->data.MemberEnd() && !found->value.IsNull())
+      {
+        info.shards = found->value.GetInt();
+      }
+
+      found = response->data.FindMember("session_start_limit");
+
+      if (found != response->data.MemberEnd() && found->value.IsObject())
+      {
+        auto& limit = found->value;
+        set_from_json(info.total_identifies, "total", limit);
+        set_from_json(info.remaining_identifies, "remaining", limit);
+        set_from_json(info.reset_after, "reset_after", limit);
+        set_from_json(info.max_concurrency, "max_concurrency", limit);
+      }
+
+      //  Older responses don't send max_concurrency, which means one identify at a time.
+      if (info.max_concurrency < 1)
+      {
+        info.max_concurrency = 1;
+      }
+
+      return info;
+    }
+
+    std::string get_wss_url(ConnectionState& conn, int* shards)
+    {
+      auto info = get_gateway_bot(conn);
 
-      //  If a shards value was sent, then populate it with the given shard amount.
-      if (found != response.data.MemberEnd() && !found->value.IsNull() && shards)
+      if (shards)
       {
-        *shards = found->value.GetInt();
+        *shards = info.shards;
       }
 
-      return response.data["url"].GetString();
+      return info.url;
     }
   }
 }
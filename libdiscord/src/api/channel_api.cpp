@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cpprest/http_client.h>
 #include "api/channel_api.h"
 #include "connection_state.h"
@@ -29,9 +30,9 @@ namespace discord
         writer.EndObject();
 
         return conn->request(Chan_CID, channel_id, Method::PATCH, "channels/" + channel_id.to_string(), sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
@@ -57,18 +58,18 @@ namespace discord
         writer.EndObject();
 
         return conn->request(Chan_CID, channel_id, Method::PATCH, "channels/" + channel_id.to_string(), sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
       pplx::task<Channel> remove(ConnectionState* conn, Snowflake channel_id)
       {
         return conn->request(Chan_CID, channel_id, Method::DEL, "channels/" + channel_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
@@ -98,10 +99,10 @@ namespace discord
         }
 
         return conn->request(Chan_CID_Messages, channel_id, Method::GET, "channels/" + channel_id.to_string() + "/messages", std::move(params))
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Message> messages;
-          for (auto& message_data : response.data.GetArray())
+          for (auto& message_data : response->data.GetArray())
           {
             messages.emplace_back(conn, message_data);
           }
@@ -110,12 +111,46 @@ namespace discord
         });
       }
 
+      Paginator<Message> iterate_messages(ConnectionState* conn, Snowflake channel_id, SearchMethod method, Snowflake start, int32_t page_size, size_t read_ahead)
+      {
+        if (method != SearchMethod::Before && method != SearchMethod::After)
+        {
+          throw DiscordException("Messages can only be walked before or after a message.");
+        }
+
+        if (method == SearchMethod::After && start.id() == 0)
+        {
+          throw DiscordException("Walking messages forward needs a message to start after.");
+        }
+
+        auto fetch = [conn, channel_id, method, page_size](Snowflake cursor)
+        {
+          //  Walking back without a message to start from starts from the newest message.
+          return get_messages(conn, channel_id, page_size, cursor.id() == 0 ? SearchMethod::None : method, cursor);
+        };
+
+        //  Pages are newest first either way, so the next cursor is the oldest or newest message of the page.
+        auto advance = [method](const std::vector<Message>& page)
+        {
+          auto older = [](const Message& lhs, const Message& rhs) { return lhs.id() < rhs.id(); };
+
+          if (method == SearchMethod::Before)
+          {
+            return std::min_element(std::begin(page), std::end(page), older)->id();
+          }
+
+          return std::max_element(std::begin(page), std::end(page), older)->id();
+        };
+
+        return Paginator<Message>(fetch, advance, start, page_size, read_ahead);
+      }
+
       pplx::task<Message> get_message(ConnectionState* conn, Snowflake channel_id, Snowflake message_id)
       {
         return conn->request(Chan_CID_Messages_MID, channel_id, Method::GET, "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Message(conn, response.data);
+          return Message(conn, response->data);
         });
       }
 
@@ -141,9 +176,9 @@ namespace discord
         writer.EndObject();
 
         return conn->request(Chan_CID_Messages, channel_id, Method::POST, "channels/" + channel_id.to_string() + "/messages", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Message(conn, response.data);
+          return Message(conn, response->data);
         });
       }
 
@@ -151,9 +186,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Messages_MID_Reactions_Emoji_Me, channel_id, Method::PUT, 
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions/" + emoji + "/@me")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -161,9 +196,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Messages_MID_Reactions_Emoji_Me, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions/" + emoji.name() + "/@me")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -171,21 +206,28 @@ namespace discord
       {
         return conn->request(Chan_CID_Messages_MID_Reactions_Emoji_UID, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions/" + emoji.name() + "/" + user_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
-      pplx::task<std::vector<User>> get_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji)
+      pplx::task<std::vector<User>> get_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji, uint32_t limit, Snowflake after)
       {
+        std::string params = "limit=" + std::to_string(limit);
+
+        if (after.id() != 0)
+        {
+          params += "&after=" + after.to_string();
+        }
+
         return conn->request(Chan_CID_Messages_MID_Reactions_Emoji, channel_id, Method::GET,
-          "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions/" + emoji.name())
-        .then([conn](APIResponse response)
+          "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions/" + emoji.name(), std::move(params))
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<User> users;
 
-          for (auto& user_data : response.data.GetArray())
+          for (auto& user_data : response->data.GetArray())
           {
             users.emplace_back(conn, user_data);
           }
@@ -194,11 +236,27 @@ namespace discord
         });
       }
 
+      Paginator<User> iterate_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id, Emoji emoji, uint32_t page_size, size_t read_ahead)
+      {
+        auto fetch = [conn, channel_id, message_id, emoji, page_size](Snowflake cursor)
+        {
+          return get_reactions(conn, channel_id, message_id, emoji, page_size, cursor);
+        };
+
+        //  Users are listed by id, so the next page starts after the highest one.
+        auto advance = [](const std::vector<User>& page)
+        {
+          return std::max_element(std::begin(page), std::end(page), [](const User& lhs, const User& rhs) { return lhs.id() < rhs.id(); })->id();
+        };
+
+        return Paginator<User>(fetch, advance, 0, page_size, read_ahead);
+      }
+
       pplx::task<void> remove_all_reactions(ConnectionState* conn, Snowflake channel_id, Snowflake message_id)
       {
         return conn->request(Chan_CID_Messages_MID_Reactions, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string() + "/reactions")
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           return;
         });
@@ -216,9 +274,9 @@ namespace discord
 
         return conn->request(Chan_CID_Messages_MID, channel_id, Method::PATCH, 
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string(), sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Message(conn, response.data);
+          return Message(conn, response->data);
         });
       }
 
@@ -226,9 +284,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Messages_MID, channel_id, Method::DEL, 
           "channels/" + channel_id.to_string() + "/messages/" + message_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -251,9 +309,9 @@ namespace discord
 
         return conn->request(Chan_CID_Messages_BulkDelete, channel_id, Method::POST,
           "channels/" + channel_id.to_string() + "/messages/bulk-delete", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -275,9 +333,9 @@ namespace discord
 
         return conn->request(Chan_CID_Perms_OID, channel_id, Method::PUT,
           "channels/" + channel_id.to_string() + "/permissions/" + overwrite.id().to_string(), sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -285,9 +343,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Perms_OID, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/permissions/" + overwrite.id().to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -295,20 +353,20 @@ namespace discord
       {
         return conn->request(Chan_CID_Typing, channel_id, Method::POST,
           "channels/" + channel_id.to_string() + "/typing")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
       pplx::task<std::vector<Message>> get_pinned_messages(ConnectionState* conn, Snowflake channel_id)
       {
         return conn->request(Chan_CID_Pins, channel_id, Method::GET, "channels/" + channel_id.to_string() + "/pins")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Message> messages;
 
-          for (auto& message_data : response.data.GetArray())
+          for (auto& message_data : response->data.GetArray())
           {
             messages.emplace_back(conn, message_data);
           }
@@ -321,9 +379,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Pins_MID, channel_id, Method::POST,
           "channels/" + channel_id.to_string() + "/pins/" + message_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -331,9 +389,9 @@ namespace discord
       {
         return conn->request(Chan_CID_Pins_MID, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/pins/" + message_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -353,7 +411,7 @@ namespace discord
 
         return conn->request(Chan_CID_Recip_UID, channel_id, Method::PUT,
           "channels/" + channel_id.to_string() + "/recipients/" + user_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           return;
         });;
@@ -363,7 +421,7 @@ namespace discord
       {
         return conn->request(Chan_CID_Recip_UID, channel_id, Method::DEL,
           "channels/" + channel_id.to_string() + "/recipients/" + user_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           return;
         });;
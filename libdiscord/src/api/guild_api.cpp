@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "api/guild_api.h"
 #include "api.h"
 #include "connection_state.h"
@@ -34,29 +36,29 @@ namespace discord
         writer.EndObject();
 
         return conn->request(Guild_GID, guild_id, Method::PATCH, "guilds/" + guild_id.to_string(), sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return discord::Guild(conn, response.data);
+          return discord::Guild(conn, response->data);
         });
       }
 
       pplx::task<discord::Guild> remove(ConnectionState* conn, Snowflake guild_id)
       {
         return conn->request(Guild_GID, guild_id, Method::DEL, "guilds/" + guild_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return discord::Guild(conn, response.data);
+          return discord::Guild(conn, response->data);
         });
       }
 
       pplx::task<std::vector<discord::Channel>> get_channels(ConnectionState* conn, Snowflake guild_id)
       {
         return conn->request(Guild_GID_Chan, guild_id, Method::GET, "guilds/" + guild_id.to_string() + "/channels")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Channel> channels;
 
-          for (auto& chan_data : response.data.GetArray())
+          for (auto& chan_data : response->data.GetArray())
           {
             channels.emplace_back(conn, chan_data);
           }
@@ -91,9 +93,9 @@ namespace discord
 
         return conn->request(Guild_GID_Chan, guild_id, Method::POST, 
           "guilds/" + guild_id.to_string() + "/channels", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
@@ -120,9 +122,9 @@ namespace discord
 
         return conn->request(Guild_GID_Chan, guild_id, Method::POST,
           "guilds/" + guild_id.to_string() + "/channels", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
@@ -145,11 +147,11 @@ namespace discord
 
         return conn->request(Guild_GID_Chan, guild_id, Method::PATCH,
           "guilds/" + guild_id.to_string() + "/channels", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Channel> channels;
 
-          for (auto& chan_data : response.data.GetArray())
+          for (auto& chan_data : response->data.GetArray())
           {
             channels.emplace_back(conn, chan_data);
           }
@@ -162,34 +164,24 @@ namespace discord
       {
         return conn->request(Guild_GID_Mem_UID, guild_id, Method::GET,
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Member(conn, response.data);
+          return Member(conn, response->data);
         });
       }
 
       pplx::task<std::vector<Member>> get_members(ConnectionState* conn, Snowflake guild_id, uint32_t limit, Snowflake after)
       {
-        rapidjson::StringBuffer sb;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-
-        writer.StartObject();
-
-        writer.String("limit");
-        writer.Int(limit);
-
-        writer.String("after");
-        writer.String(after.to_string());
-
-        writer.EndObject();
+        //  GET parameters go in the query string.
+        std::string params = "limit=" + std::to_string(limit) + "&after=" + after.to_string();
 
         return conn->request(Guild_GID_Mem, guild_id, Method::GET,
-          "guilds/" + guild_id.to_string() + "/members", sb.GetString())
-        .then([conn](APIResponse response)
+          "guilds/" + guild_id.to_string() + "/members", std::move(params))
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Member> members;
 
-          for (auto& member_data : response.data.GetArray())
+          for (auto& member_data : response->data.GetArray())
           {
             members.emplace_back(conn, member_data);
           }
@@ -198,6 +190,21 @@ namespace discord
         });
       }
 
+      Paginator<Member> iterate_members(ConnectionState* conn, Snowflake guild_id, uint32_t page_size, size_t read_ahead)
+      {
+        auto fetch = [conn, guild_id, page_size](Snowflake cursor)
+        {
+          return get_members(conn, guild_id, page_size, cursor);
+        };
+
+        auto advance = [](const std::vector<Member>& page)
+        {
+          return std::max_element(std::begin(page), std::end(page), [](const Member& lhs, const Member& rhs) { return lhs.user().id() < rhs.user().id(); })->user().id();
+        };
+
+        return Paginator<Member>(fetch, advance, 0, page_size, read_ahead);
+      }
+
       pplx::task<bool> add_member(ConnectionState* conn, Snowflake guild_id, Snowflake user_id, std::string access_token, std::string nick, std::vector<Role> roles, bool muted, bool deafened)
       {
         rapidjson::StringBuffer sb;
@@ -231,9 +238,9 @@ namespace discord
 
         return conn->request(Guild_GID_Mem_UID, guild_id, Method::PUT, 
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 201;
+          return response->status_code == 201;
         });
       }
 
@@ -273,9 +280,9 @@ namespace discord
 
         return conn->request(Guild_GID_Mem_UID, guild_id, Method::PATCH,
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 201;
+          return response->status_code == 201;
         });
       }
 
@@ -293,9 +300,9 @@ namespace discord
 
         return conn->request(Guild_GID_Mem_Me_Nick, guild_id, Method::PATCH, 
           "guilds/" + guild_id.to_string() + "/members/@me/nick", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 200;
+          return response->status_code == 200;
         });
       }
 
@@ -303,9 +310,9 @@ namespace discord
       {
         return conn->request(Guild_GID_Mem_UID_Role_RID, guild_id, Method::PUT,
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string() + "/roles/" + role_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -313,9 +320,9 @@ namespace discord
       {
         return conn->request(Guild_GID_Mem_UID_Role_RID, guild_id, Method::DEL,
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string() + "/roles/" + role_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });;
       }
 
@@ -323,21 +330,28 @@ namespace discord
       {
         return conn->request(Guild_GID_Mem_UID, guild_id, Method::DEL,
           "guilds/" + guild_id.to_string() + "/members/" + user_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });;
       }
 
-      pplx::task<std::vector<discord::User>> get_bans(ConnectionState* conn, Snowflake guild_id)
+      pplx::task<std::vector<discord::User>> get_bans(ConnectionState* conn, Snowflake guild_id, uint32_t limit, Snowflake after)
       {
+        std::string params;
+
+        if (limit != 0)
+        {
+          params = "limit=" + std::to_string(limit) + "&after=" + after.to_string();
+        }
+
         return conn->request(Guild_GID_Bans, guild_id, Method::GET,
-          "guilds/" + guild_id.to_string() + "/bans")
-        .then([conn](APIResponse response)
+          "guilds/" + guild_id.to_string() + "/bans", std::move(params))
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<User> users;
 
-          for (auto& user_data : response.data.GetArray())
+          for (auto& user_data : response->data.GetArray())
           {
             users.emplace_back(conn, user_data);
           }
@@ -346,6 +360,22 @@ namespace discord
         });
       }
 
+      Paginator<User> iterate_bans(ConnectionState* conn, Snowflake guild_id, uint32_t page_size, size_t read_ahead)
+      {
+        auto fetch = [conn, guild_id, page_size](Snowflake cursor)
+        {
+          return get_bans(conn, guild_id, page_size, cursor);
+        };
+
+        //  If Discord ignores the cursor and sends every ban at once, the repeated page ends the walk.
+        auto advance = [](const std::vector<User>& page)
+        {
+          return std::max_element(std::begin(page), std::end(page), [](const User& lhs, const User& rhs) { return lhs.id() < rhs.id(); })->id();
+        };
+
+        return Paginator<User>(fetch, advance, 0, page_size, read_ahead);
+      }
+
       pplx::task<bool> ban(ConnectionState* conn, Snowflake guild_id, Snowflake user_id, uint32_t delete_x_days)
       {
         if (delete_x_days > 7)
@@ -365,9 +395,9 @@ namespace discord
 
         return conn->request(Guild_GID_Bans_UID, guild_id, Method::PUT, 
           "guilds/" + guild_id.to_string() + "/bans/" + user_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -375,21 +405,53 @@ namespace discord
       {
         return conn->request(Guild_GID_Bans_UID, guild_id, Method::DEL,
           "guilds/" + guild_id.to_string() + "/bans/" + user_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
+      BulkModeration bulk_ban(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, uint32_t delete_x_days, BulkModeration::ProgressHandler progress)
+      {
+        return BulkModeration(conn, Guild_GID_Bans_UID, guild_id, std::move(user_ids), [conn, guild_id, delete_x_days](Snowflake user_id)
+        {
+          return ban(conn, guild_id, user_id, delete_x_days);
+        }, progress);
+      }
+
+      BulkModeration bulk_kick(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, BulkModeration::ProgressHandler progress)
+      {
+        return BulkModeration(conn, Guild_GID_Mem_UID, guild_id, std::move(user_ids), [conn, guild_id](Snowflake user_id)
+        {
+          return remove_member(conn, guild_id, user_id);
+        }, progress);
+      }
+
+      BulkModeration bulk_add_role(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress)
+      {
+        return BulkModeration(conn, Guild_GID_Mem_UID_Role_RID, guild_id, std::move(user_ids), [conn, guild_id, role_id](Snowflake user_id)
+        {
+          return add_member_role(conn, guild_id, user_id, role_id);
+        }, progress);
+      }
+
+      BulkModeration bulk_remove_role(ConnectionState* conn, Snowflake guild_id, std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress)
+      {
+        return BulkModeration(conn, Guild_GID_Mem_UID_Role_RID, guild_id, std::move(user_ids), [conn, guild_id, role_id](Snowflake user_id)
+        {
+          return remove_member_role(conn, guild_id, user_id, role_id);
+        }, progress);
+      }
+
       pplx::task<std::vector<Role>> get_roles(ConnectionState* conn, Snowflake guild_id)
       {
         return conn->request(Guild_GID_Roles, guild_id, Method::GET,
           "guilds/" + guild_id.to_string() + "/roles")
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           std::vector<Role> roles;
 
-          for (auto& role_data : response.data.GetArray())
+          for (auto& role_data : response->data.GetArray())
           {
             roles.emplace_back(role_data);
           }
@@ -424,9 +486,9 @@ namespace discord
 
         return conn->request(Guild_GID_Roles, guild_id, Method::POST, 
           "guilds/" + guild_id.to_string() + "/roles", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return Role(response.data);
+          return Role(response->data);
         });
       }
 
@@ -449,11 +511,11 @@ namespace discord
 
         return conn->request(Guild_GID_Roles, guild_id, Method::PATCH,
           "guilds/" + guild_id.to_string() + "/roles", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           std::vector<Role> roles;
 
-          for (auto& role_data : response.data.GetArray())
+          for (auto& role_data : response->data.GetArray())
           {
             roles.emplace_back(role_data);
           }
@@ -488,9 +550,9 @@ namespace discord
 
         return conn->request(Guild_GID_Roles_RID, guild_id, Method::PATCH, 
           "guilds/" + guild_id.to_string() + "/roles/" + role_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return Role(response.data);
+          return Role(response->data);
         });
       }
 
@@ -498,9 +560,9 @@ namespace discord
       {
         return conn->request(Guild_GID_Roles_RID, guild_id, Method::DEL,
           "guilds/" + guild_id.to_string() + "/roles/" + role_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -518,9 +580,9 @@ namespace discord
 
         return conn->request(Guild_GID_Prune, guild_id, Method::GET, 
           "guilds/" + guild_id.to_string() + "/prune", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.data.GetUint();
+          return response->data.GetUint();
         });
       }
 
@@ -538,9 +600,9 @@ namespace discord
 
         return conn->request(Guild_GID_Prune, guild_id, Method::POST, 
           "guilds/" + guild_id.to_string() + "/prune", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.data["pruned"].GetUint();
+          return response->data["pruned"].GetUint();
         });
       }
 
@@ -548,11 +610,11 @@ namespace discord
       {
         return conn->request(Guild_GID_Regions, guild_id, Method::GET,
           "guilds/" + guild_id.to_string() + "/regions")
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           std::vector<VoiceRegion> regions;
 
-          for (auto& region_data : response.data.GetArray())
+          for (auto& region_data : response->data.GetArray())
           {
             regions.emplace_back(region_data);
           }
@@ -565,13 +627,13 @@ namespace discord
       {
         return conn->request(Guild_GID_Int, guild_id, Method::GET,
           "guilds/" + guild_id.to_string() + "/integrations")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Integration> integrations;
 
-          for (auto& integration_data : response.data.GetArray())
+          for (auto& integration_data : response->data.GetArray())
           {
-            integrations.emplace_back(conn, response.data);
+            integrations.emplace_back(conn, response->data);
           }
 
           return integrations;
@@ -595,9 +657,9 @@ namespace discord
 
         return conn->request(Guild_GID_Int, guild_id, Method::POST,
           "guilds/" + guild_id.to_string() + "/integrations", sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -621,9 +683,9 @@ namespace discord
 
         return conn->request(Guild_GID_Int_IID, guild_id, Method::PATCH,
           "guilds/" + guild_id.to_string() + "/integrations/" + integration_id.to_string(), sb.GetString())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -631,9 +693,9 @@ namespace discord
       {
         return conn->request(Guild_GID_Int_IID, guild_id, Method::DEL,
           "guilds/" + guild_id.to_string() + "/integrations/" + integration_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
@@ -641,9 +703,9 @@ namespace discord
       {
         return conn->request(Guild_GID_Int_IID_Sync, guild_id, Method::POST,
           "guilds/" + guild_id.to_string() + "/integrations/" + integration_id.to_string() + "/sync")
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
     }
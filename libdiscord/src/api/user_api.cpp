@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "api/user_api.h"
 #include "connection_state.h"
 #include "discord_exception.h"
@@ -11,18 +13,18 @@ namespace discord
       pplx::task<User> get_current_user(ConnectionState* conn)
       {
         return conn->request(User_Me, 0, Method::GET, "users/@me")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return User(conn, response.data);
+          return User(conn, response->data);
         });
       }
 
       pplx::task<User> get_user(ConnectionState* conn, Snowflake user_id)
       {
         return conn->request(User_UID, 0, Method::GET, "users/" + user_id.to_string())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return User(conn, response.data);
+          return User(conn, response->data);
         });
       }
 
@@ -39,9 +41,9 @@ namespace discord
         writer.EndObject();
 
         return conn->request(User_Me, 0, Method::PATCH, "users/@me", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return User(conn, response.data);
+          return User(conn, response->data);
         });
       }
 
@@ -58,39 +60,30 @@ namespace discord
           limit = 100;
         }
 
-        rapidjson::StringBuffer sb;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-
-        writer.StartObject();
-
-        writer.String("limit");
-        writer.Int(limit);
+        //  GET parameters go in the query string.
+        std::string params = "limit=" + std::to_string(limit);
 
         if (guild_id.id() != 0)
         {
           switch (method)
           {
           case SearchMethod::After:
-            writer.String("after");
-            writer.String(guild_id.to_string());
+            params += "&after=" + guild_id.to_string();
             break;
           case SearchMethod::Before:
-            writer.String("before");
-            writer.String(guild_id.to_string());
+            params += "&before=" + guild_id.to_string();
             break;
           default:
             break;
           }
         }
 
-        writer.EndObject();
-
-        return conn->request(User_Me_Guild, 0, Method::GET, "users/@me/guilds", sb.GetString())
-        .then([](APIResponse response)
+        return conn->request(User_Me_Guild, 0, Method::GET, "users/@me/guilds", std::move(params))
+        .then([](std::shared_ptr<APIResponse> response)
         {
           std::vector<user_guild> user_guilds;
 
-          for (auto& ug_data : response.data.GetArray())
+          for (auto& ug_data : response->data.GetArray())
           {
             user_guilds.emplace_back(ug_data);
           }
@@ -99,23 +92,41 @@ namespace discord
         });
       }
 
+      Paginator<user_guild> iterate_guilds(ConnectionState* conn, uint32_t page_size, size_t read_ahead)
+      {
+        //  guilds would cut a bigger page down, which would look like the last page.
+        page_size = std::min<uint32_t>(page_size, 100);
+
+        auto fetch = [conn, page_size](Snowflake cursor)
+        {
+          return guilds(conn, page_size, SearchMethod::After, cursor);
+        };
+
+        auto advance = [](const std::vector<user_guild>& page)
+        {
+          return std::max_element(std::begin(page), std::end(page), [](const user_guild& lhs, const user_guild& rhs) { return lhs.id() < rhs.id(); })->id();
+        };
+
+        return Paginator<user_guild>(fetch, advance, 0, page_size, read_ahead);
+      }
+
       pplx::task<bool> leave_guild(ConnectionState* conn, Snowflake guild_id)
       {
         return conn->request(User_Me_Guild_GID, 0, Method::DEL, "users/@me/guilds/" + guild_id.to_string())
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
-          return response.status_code == 204;
+          return response->status_code == 204;
         });
       }
 
       pplx::task<std::vector<Channel>> get_dms(ConnectionState* conn)
       {
         return conn->request(User_Me_Channel, 0, Method::GET, "users/@me/channels")
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
           std::vector<Channel> channels;
 
-          for (auto& chan_data : response.data.GetArray())
+          for (auto& chan_data : response->data.GetArray())
           {
             channels.emplace_back(conn, chan_data);
           }
@@ -137,9 +148,9 @@ namespace discord
         writer.EndObject();
 
         return conn->request(User_Me_Channel, 0, Method::POST, "users/@me/channels", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
@@ -160,20 +171,20 @@ namespace discord
 
         return conn->request(User_Me_Channel, 0, Method::POST,
           "users/@me/channels", sb.GetString())
-        .then([conn](APIResponse response)
+        .then([conn](std::shared_ptr<APIResponse> response)
         {
-          return Channel(conn, response.data);
+          return Channel(conn, response->data);
         });
       }
 
       pplx::task<std::vector<Connection>> connections(ConnectionState* conn)
       {
         return conn->request(User_Me_Connections, 0, Method::GET, "users/@me/connections")
-        .then([](APIResponse response)
+        .then([](std::shared_ptr<APIResponse> response)
         {
           std::vector<Connection> connections;
 
-          for (auto& conn_data : response.data.GetArray())
+          for (auto& conn_data : response->data.GetArray())
           {
             connections.emplace_back(conn_data);
           }
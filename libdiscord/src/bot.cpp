@@ -7,6 +7,7 @@
 #include "event/message_event.h"
 #include "gateway.h"
 #include "guild.h"
+#include "http_transport.h"
 #include "member.h"
 #include "role.h"
 #include "user.h"
@@ -73,11 +74,11 @@ namespace discord
         if (m_on_message_deleted)
         {
           std::vector<Snowflake> ids;
-          Snowflake chan_id(data["channel_id"].GetString());
+          Snowflake chan_id(data["channel_id"]);
 
           for (const auto& id : data["ids"].GetArray())
           {
-            ids.emplace_back(id.GetString());
+            ids.emplace_back(id);
           }
 
           LOG(DEBUG) << "Sending out " << ids.size() << " MessageDeletedEvents";
@@ -88,16 +89,8 @@ namespace discord
             m_on_message_deleted(event);
           }
         }
+        break;
       }
-	case GuildCreated:
-	  {
-		if(m_on_guild_created)
-		{
-			Guild guild(m_conn_state.get(), data);
-			m_on_guild_created(guild);
-		}
-		break;
-	  }
     case PresenceUpdate:
       {
         if (m_on_presence)
@@ -122,16 +115,85 @@ namespace discord
     }
   }
 
-  Bot::Bot(std::string token, std::string prefix, int shards) : m_prefix(prefix)
+  Bot::Bot(std::string token, std::string prefix, int shards, Encoding encoding) : m_prefix(prefix)
   {
-    m_conn_state = std::make_unique<ConnectionState>("Bot " + token, shards);
+    m_conn_state = std::make_unique<ConnectionState>("Bot " + token, shards, encoding);
     m_conn_state->on_event(std::bind(&Bot::on_event, this, std::placeholders::_1, std::placeholders::_2));
+
+    //  Guilds are passed on as they are cached, so they aren't built a second time from the payload.
+    m_conn_state->on_guild_created([this](Guild& guild)
+    {
+      if (m_on_guild_created)
+      {
+        m_on_guild_created(guild);
+      }
+    });
   }
 
   Bot::~Bot()
   {
   }
 
+  void Bot::ignore_event(DispatchEvent event)
+  {
+    m_conn_state->filter().ignore(event);
+  }
+
+  void Bot::allow_guilds(const std::vector<Snowflake>& guilds)
+  {
+    m_conn_state->filter().allow_guilds(guilds);
+  }
+
+  LatencyStats Bot::latency(int shard) const
+  {
+    return m_conn_state->latency(shard);
+  }
+
+  void Bot::set_max_missed_acks(uint32_t max_missed_acks)
+  {
+    m_conn_state->set_max_missed_acks(max_missed_acks);
+  }
+
+  void Bot::set_large_threshold(uint8_t threshold)
+  {
+    m_conn_state->set_large_threshold(threshold);
+  }
+
+  pplx::task<uint32_t> Bot::request_members(const std::vector<Snowflake>& guild_ids)
+  {
+    return m_conn_state->request_members(guild_ids);
+  }
+
+  void Bot::set_shard_range(int first, int last)
+  {
+    m_conn_state->set_shard_range(first, last);
+  }
+
+  void Bot::join_cluster(const std::string& path, const std::string& name)
+  {
+    m_conn_state->join_cluster(path, name);
+  }
+
+  GuildOwner Bot::guild_owner(Snowflake guild_id) const
+  {
+    return m_conn_state->guild_owner(guild_id);
+  }
+
+  void Bot::set_http_transport(std::unique_ptr<HttpTransport> transport)
+  {
+    m_conn_state->set_http_transport(std::move(transport));
+  }
+
+  void Bot::set_cache_ttl(APIKey key, std::chrono::milliseconds ttl)
+  {
+    m_conn_state->response_cache().set_ttl(key, ttl);
+  }
+
+  void Bot::persist_sessions(const std::string& directory)
+  {
+    m_conn_state->persist_sessions(directory);
+  }
+
   void Bot::run(bool async) const
   {
     m_conn_state->connect();
@@ -188,16 +250,20 @@ namespace discord
   void Bot::on_message(std::function<void(MessageEvent&)> callback)
   {
     m_on_message = callback;
+    m_conn_state->filter().consume(DispatchEvent::MessageCreate);
   }
 
   void Bot::on_message_edited(std::function<void(MessageEvent&)> callback)
   {
     m_on_message_edited = callback;
+    m_conn_state->filter().consume(DispatchEvent::MessageUpdate);
   }
 
   void Bot::on_message_deleted(std::function<void(MessageDeletedEvent&)> callback)
   {
     m_on_message_deleted = callback;
+    m_conn_state->filter().consume(DispatchEvent::MessageDelete);
+    m_conn_state->filter().consume(DispatchEvent::MessageDeleteBulk);
   }
 
   void Bot::on_emoji_created(std::function<void(Emoji&)> callback)
@@ -228,10 +294,12 @@ namespace discord
   void Bot::on_typing(std::function<void(TypingEvent&)> callback)
   {
     m_on_typing = callback;
+    m_conn_state->filter().consume(DispatchEvent::TypingStart);
   }
 
   void Bot::add_command(std::string name, std::function<void(MessageEvent)> callback)
   {
     m_commands[name] = callback;
+    m_conn_state->filter().consume(DispatchEvent::MessageCreate);
   }
 }
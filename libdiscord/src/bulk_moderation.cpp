@@ -0,0 +1,132 @@
+#include <algorithm>
+
+#include "bulk_moderation.h"
+#include "connection_state.h"
+
+namespace discord
+{
+  const size_t BulkModeration::MAX_CONCURRENCY = 50;
+
+  void BulkModeration::pump(std::shared_ptr<State> state)
+  {
+    //  Unknown until the first response, in which case a single request finds out.
+    auto limit = state->conn->rate_limiter().limit(state->key, state->major);
+    auto window = std::min(static_cast<size_t>(std::max<int32_t>(limit, 1)), MAX_CONCURRENCY);
+    std::vector<Snowflake> starting;
+
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+
+      while (!state->cancelled && state->next < state->targets.size() && state->in_flight < window)
+      {
+        starting.push_back(state->targets[state->next++]);
+        ++state->in_flight;
+      }
+
+      if (starting.empty() && state->in_flight == 0)
+      {
+        state->result.skipped = state->targets.size() - state->next;
+        state->done.set(state->result);
+        return;
+      }
+    }
+
+    for (auto user_id : starting)
+    {
+      run(state, user_id);
+    }
+  }
+
+  void BulkModeration::run(std::shared_ptr<State> state, Snowflake user_id)
+  {
+    pplx::task<bool> task;
+
+    try
+    {
+      task = state->action(user_id);
+    }
+    catch (...)
+    {
+      task = pplx::task_from_exception<bool>(std::current_exception());
+    }
+
+    task.then([state, user_id](pplx::task<bool> result)
+    {
+      ModerationProgress progress;
+      progress.user_id = user_id;
+
+      try
+      {
+        progress.succeeded = result.get();
+
+        if (!progress.succeeded)
+        {
+          progress.error = "Discord did not confirm the action.";
+        }
+      }
+      catch (const std::exception& e)
+      {
+        progress.succeeded = false;
+        progress.error = e.what();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        --state->in_flight;
+
+        if (progress.succeeded)
+        {
+          ++state->result.succeeded;
+        }
+        else
+        {
+          state->result.failures.push_back({ user_id, progress.error });
+        }
+
+        progress.failed = state->result.failures.size();
+        progress.completed = state->result.succeeded + progress.failed;
+        progress.total = state->targets.size();
+      }
+
+      if (state->progress)
+      {
+        std::lock_guard<std::mutex> lock(state->progress_mutex);
+        state->progress(progress);
+      }
+
+      pump(state);
+    });
+  }
+
+  BulkModeration::BulkModeration(ConnectionState* conn, APIKey key, Snowflake major, std::vector<Snowflake> user_ids, Action action, ProgressHandler progress)
+    : m_state(std::make_shared<State>())
+  {
+    m_state->conn = conn;
+    m_state->key = key;
+    m_state->major = major;
+    m_state->action = action;
+    m_state->targets = std::move(user_ids);
+    m_state->next = 0;
+    m_state->in_flight = 0;
+    m_state->cancelled = false;
+    m_state->progress = progress;
+
+    pump(m_state);
+  }
+
+  void BulkModeration::cancel()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_state->mutex);
+      m_state->cancelled = true;
+    }
+
+    //  Finishes the run right away if nothing is in flight.
+    pump(m_state);
+  }
+
+  pplx::task<ModerationResult> BulkModeration::result() const
+  {
+    return pplx::create_task(m_state->done);
+  }
+}
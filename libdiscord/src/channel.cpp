@@ -161,6 +161,11 @@ namespace discord
     return api::channel::get_messages(m_owner, m_id, limit, method, pivot);
   }
 
+  Paginator<Message> Channel::iterate_messages(SearchMethod method, Snowflake start, int32_t page_size, size_t read_ahead) const
+  {
+    return api::channel::iterate_messages(m_owner, m_id, method, start, page_size, read_ahead);
+  }
+
   pplx::task<Message> Channel::get_message(Snowflake message_id) const
   {
     return api::channel::get_message(m_owner, m_id, message_id);
@@ -204,6 +209,11 @@ namespace discord
     return api::channel::get_reactions(m_owner, m_id, message_id, emoji);
   }
 
+  Paginator<User> Channel::iterate_reactions(Snowflake message_id, Emoji emoji, uint32_t page_size, size_t read_ahead) const
+  {
+    return api::channel::iterate_reactions(m_owner, m_id, message_id, emoji, page_size, read_ahead);
+  }
+
   pplx::task<void> Channel::remove_all_reactions(Snowflake message_id) const
   {
     return api::channel::remove_all_reactions(m_owner, m_id, message_id);
@@ -226,20 +236,23 @@ namespace discord
 
   pplx::task<bool> Channel::remove_messages(int amount) const
   {
-    if (amount < 2 || amount > 100)
+    if (amount < 1)
     {
-      throw DiscordException("Bulk message delete amount must be between 2 and 100 inclusive.");
+      throw DiscordException("Message delete amount must be at least 1.");
     }
 
-    return api::channel::get_messages(m_owner, m_id, amount)
-      .then([owner = m_owner, id = m_id](std::vector<Message> messages) {
-        std::vector<Snowflake> msg_ids(messages.size());
-        std::transform(std::begin(messages), std::end(messages), std::begin(msg_ids), 
-          [](const Message& msg) -> Snowflake {
-            return msg.id();
-          });
-        return api::channel::bulk_remove_messages(owner, id, msg_ids).get();
-      });
+    PurgeOptions options;
+    options.limit = amount;
+
+    return purge_messages(options).then([](PurgeResult result)
+    {
+      return result.deleted == result.matched;
+    });
+  }
+
+  pplx::task<PurgeResult> Channel::purge_messages(PurgeOptions options) const
+  {
+    return api::channel::purge_messages(m_owner, m_id, options);
   }
 
   pplx::task<bool> Channel::edit_permissions(Overwrite overwrite, uint32_t allow, uint32_t deny, std::string type) const
@@ -0,0 +1,63 @@
+#include "circuit_breaker.h"
+
+namespace discord
+{
+  const uint32_t CircuitBreaker::FAILURE_THRESHOLD = 5;
+  const std::chrono::milliseconds CircuitBreaker::OPEN_DURATION = std::chrono::milliseconds(15000);
+
+  bool CircuitBreaker::allow(APIKey key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_circuits.find(key);
+
+    if (found == std::end(m_circuits) || found->second.failures < FAILURE_THRESHOLD)
+    {
+      return true;
+    }
+
+    auto& circuit = found->second;
+
+    if (circuit.probing || std::chrono::steady_clock::now() < circuit.open_until)
+    {
+      return false;
+    }
+
+    //  Half open, let one request through to find out whether the route recovered.
+    circuit.probing = true;
+    return true;
+  }
+
+  void CircuitBreaker::record_success(APIKey key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_circuits.find(key);
+
+    if (found != std::end(m_circuits))
+    {
+      if (found->second.failures >= FAILURE_THRESHOLD)
+      {
+        LOG(INFO) << "Route " << key << " recovered, closing its circuit.";
+      }
+
+      m_circuits.erase(found);
+    }
+  }
+
+  void CircuitBreaker::record_failure(APIKey key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& circuit = m_circuits[key];
+
+    circuit.probing = false;
+
+    if (++circuit.failures >= FAILURE_THRESHOLD)
+    {
+      if (circuit.failures == FAILURE_THRESHOLD)
+      {
+        LOG(WARNING) << "Route " << key << " failed " << FAILURE_THRESHOLD << " times in a row, failing its requests for " << OPEN_DURATION.count() << "ms.";
+      }
+
+      circuit.open_until = std::chrono::steady_clock::now() + OPEN_DURATION;
+    }
+  }
+}
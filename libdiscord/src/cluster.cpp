@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "cluster.h"
+#include "discord_exception.h"
+#include "identify_scheduler.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace discord
+{
+  const std::chrono::milliseconds ClusterClient::REPLY_TIMEOUT = std::chrono::milliseconds(5000);
+
+  namespace
+  {
+    //  A client that sends this much without a newline isn't speaking the protocol.
+    const size_t MAX_LINE_LENGTH = 4096;
+
+    /** Removes the first full line from a buffer.
+     *
+     * @param buffer The data received so far.
+     * @param line Set to the line, without its newline.
+     * @return False if there is no full line yet.
+     */
+    bool take_line(std::string& buffer, std::string& line)
+    {
+      auto end = buffer.find('\n');
+
+      if (end == std::string::npos)
+      {
+        return false;
+      }
+
+      line.assign(buffer, 0, end);
+      buffer.erase(0, end + 1);
+      return true;
+    }
+
+#ifndef _WIN32
+    /** Sends a line over a socket.
+     *
+     * @return False if the socket was closed.
+     */
+    bool write_line(int fd, std::string line)
+    {
+      line += '\n';
+
+      for (size_t sent = 0; sent < line.size();)
+      {
+        auto written = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+
+        if (written <= 0)
+        {
+          return false;
+        }
+
+        sent += written;
+      }
+
+      return true;
+    }
+
+    /** Creates a Unix socket address.
+     *  Throws a DiscordException if the path doesn't fit.
+     */
+    sockaddr_un make_address(const std::string& path)
+    {
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+
+      if (path.size() >= sizeof(address.sun_path))
+      {
+        LOG(ERROR) << "Cluster socket path is too long: " << path;
+        throw DiscordException("Cluster socket path is too long: " + path);
+      }
+
+      std::memcpy(address.sun_path, path.c_str(), path.size());
+      return address;
+    }
+#endif
+  }
+
+  ClusterCoordinator::ClusterCoordinator(const std::string& path, int total_shards, int shards_per_process)
+    : m_path(path), m_total_shards(std::max(total_shards, 1)), m_shards_per_process(std::max(shards_per_process, 1)), m_listen_fd(-1)
+  {
+    m_wake_fds[0] = -1;
+    m_wake_fds[1] = -1;
+
+    auto ranges = (m_total_shards + m_shards_per_process - 1) / m_shards_per_process;
+    m_range_owners.assign(ranges, -1);
+  }
+
+  ClusterCoordinator::~ClusterCoordinator()
+  {
+    stop();
+  }
+
+  std::string ClusterCoordinator::handle(Client& client, const std::string& line)
+  {
+    std::istringstream stream(line);
+    std::string command;
+    stream >> command;
+
+    if (command == "JOIN")
+    {
+      std::string name;
+      stream >> name;
+
+      if (name.empty())
+      {
+        return "ERROR missing process name";
+      }
+
+      if (client.range < 0)
+      {
+        auto free = std::find(std::begin(m_range_owners), std::end(m_range_owners), -1);
+
+        if (free == std::end(m_range_owners))
+        {
+          LOG(WARNING) << "Process " << name << " tried to join, but every shard range is taken.";
+          return "ERROR no free shard range";
+        }
+
+        *free = client.fd;
+        client.range = static_cast<int>(free - std::begin(m_range_owners));
+        client.name = name;
+      }
+
+      auto first = client.range * m_shards_per_process;
+      auto last = std::min(first + m_shards_per_process, m_total_shards);
+
+      LOG(INFO) << "Process " << client.name << " runs shards " << first << " to " << last - 1 << " of " << m_total_shards << ".";
+      return "RANGE " + std::to_string(first) + " " + std::to_string(last) + " " + std::to_string(m_total_shards);
+    }
+
+    if (command == "IDENTIFY")
+    {
+      int shard = 0;
+      int max_concurrency = 1;
+      stream >> shard >> max_concurrency;
+      max_concurrency = std::max(max_concurrency, 1);
+
+      auto now = std::chrono::steady_clock::now();
+
+      if (m_bucket_ready.size() != static_cast<size_t>(max_concurrency))
+      {
+        m_bucket_ready.assign(max_concurrency, now);
+      }
+
+      auto& ready = m_bucket_ready[std::max(shard, 0) % max_concurrency];
+      auto slot = std::max(now, ready);
+      ready = slot + IdentifyScheduler::IDENTIFY_INTERVAL;
+
+      return "DELAY " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(slot - now).count());
+    }
+
+    if (command == "OWNER")
+    {
+      uint64_t guild_id = 0;
+      stream >> guild_id;
+
+      auto shard = static_cast<int>((guild_id >> 22) % m_total_shards);
+      auto owner_fd = m_range_owners[shard / m_shards_per_process];
+      auto owner = std::find_if(std::begin(m_clients), std::end(m_clients), [owner_fd](const Client& c) { return c.fd == owner_fd; });
+
+      auto reply = "OWNER " + std::to_string(shard);
+
+      if (owner_fd >= 0 && owner != std::end(m_clients))
+      {
+        reply += " " + owner->name;
+      }
+
+      return reply;
+    }
+
+    return "ERROR unknown command " + command;
+  }
+
+#ifndef _WIN32
+  void ClusterCoordinator::run()
+  {
+    std::vector<pollfd> fds;
+
+    while (true)
+    {
+      fds.clear();
+      fds.push_back({ m_wake_fds[0], POLLIN, 0 });
+      fds.push_back({ m_listen_fd, POLLIN, 0 });
+
+      for (const auto& client : m_clients)
+      {
+        fds.push_back({ client.fd, POLLIN, 0 });
+      }
+
+      if (poll(fds.data(), fds.size(), -1) < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+
+        LOG(ERROR) << "Cluster coordinator stopped, poll failed: " << std::strerror(errno);
+        break;
+      }
+
+      //  Woken up by stop.
+      if (fds[0].revents)
+      {
+        break;
+      }
+
+      if (fds[1].revents & POLLIN)
+      {
+        auto fd = accept(m_listen_fd, nullptr, nullptr);
+
+        if (fd >= 0)
+        {
+          m_clients.push_back({ fd, "", "", -1 });
+        }
+      }
+
+      //  Go backwards so dropping a client doesn't move the ones still to be handled.
+      for (auto i = fds.size(); i-- > 2;)
+      {
+        if (!fds[i].revents)
+        {
+          continue;
+        }
+
+        auto index = i - 2;
+        auto& client = m_clients[index];
+
+        char data[512];
+        auto received = recv(client.fd, data, sizeof(data), 0);
+
+        if (received <= 0)
+        {
+          drop(index);
+          continue;
+        }
+
+        client.buffer.append(data, received);
+
+        std::string line;
+        auto connected = true;
+
+        while (connected && take_line(client.buffer, line))
+        {
+          connected = write_line(client.fd, handle(client, line));
+        }
+
+        if (!connected || client.buffer.size() > MAX_LINE_LENGTH)
+        {
+          drop(index);
+        }
+      }
+    }
+  }
+
+  void ClusterCoordinator::drop(size_t index)
+  {
+    auto& client = m_clients[index];
+
+    if (client.range >= 0)
+    {
+      LOG(INFO) << "Process " << client.name << " left the cluster, its shard range is free.";
+      m_range_owners[client.range] = -1;
+    }
+
+    close(client.fd);
+    m_clients.erase(std::begin(m_clients) + index);
+  }
+
+  void ClusterCoordinator::start()
+  {
+    auto address = make_address(m_path);
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    //  A socket file left behind by a coordinator that didn't shut down cleanly would block bind.
+    unlink(m_path.c_str());
+
+    if (m_listen_fd < 0 ||
+      bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(m_listen_fd, SOMAXCONN) != 0 ||
+      pipe(m_wake_fds) != 0)
+    {
+      auto error = std::strerror(errno);
+      stop();
+
+      LOG(ERROR) << "Could not listen for cluster processes on " << m_path << ": " << error;
+      throw DiscordException("Could not listen for cluster processes on " + m_path + ": " + error);
+    }
+
+    m_thread = std::thread(&ClusterCoordinator::run, this);
+  }
+
+  void ClusterCoordinator::stop()
+  {
+    if (m_thread.joinable())
+    {
+      auto written = write(m_wake_fds[1], "x", 1);
+      (void)written;
+      m_thread.join();
+    }
+
+    while (!m_clients.empty())
+    {
+      drop(m_clients.size() - 1);
+    }
+
+    for (auto fd : { m_listen_fd, m_wake_fds[0], m_wake_fds[1] })
+    {
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+    }
+
+    if (m_listen_fd >= 0)
+    {
+      unlink(m_path.c_str());
+    }
+
+    m_listen_fd = -1;
+    m_wake_fds[0] = -1;
+    m_wake_fds[1] = -1;
+  }
+
+  std::string ClusterClient::request(const std::string& line)
+  {
+    if (!write_line(m_fd, line))
+    {
+      throw DiscordException("Lost the connection to the cluster coordinator.");
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + REPLY_TIMEOUT;
+    std::string reply;
+
+    while (!take_line(m_buffer, reply))
+    {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+      if (left.count() <= 0)
+      {
+        throw DiscordException("The cluster coordinator did not reply to " + line);
+      }
+
+      pollfd fd = { m_fd, POLLIN, 0 };
+
+      if (poll(&fd, 1, static_cast<int>(left.count())) <= 0)
+      {
+        continue;
+      }
+
+      char data[512];
+      auto received = recv(m_fd, data, sizeof(data), 0);
+
+      if (received <= 0)
+      {
+        throw DiscordException("Lost the connection to the cluster coordinator.");
+      }
+
+      m_buffer.append(data, received);
+    }
+
+    return reply;
+  }
+
+  ClusterClient::ClusterClient(const std::string& path) : m_fd(-1)
+  {
+    auto address = make_address(path);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (m_fd < 0 || connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+      auto error = std::strerror(errno);
+
+      if (m_fd >= 0)
+      {
+        close(m_fd);
+      }
+
+      LOG(ERROR) << "Could not connect to the cluster coordinator at " << path << ": " << error;
+      throw DiscordException("Could not connect to the cluster coordinator at " + path + ": " + error);
+    }
+  }
+
+  ClusterClient::~ClusterClient()
+  {
+    if (m_fd >= 0)
+    {
+      close(m_fd);
+    }
+  }
+#else
+  void ClusterCoordinator::run()
+  {
+  }
+
+  void ClusterCoordinator::drop(size_t index)
+  {
+    m_clients.erase(std::begin(m_clients) + index);
+  }
+
+  void ClusterCoordinator::start()
+  {
+    LOG(ERROR) << "Cluster mode needs Unix sockets, which are not supported on this platform.";
+    throw DiscordException("Cluster mode needs Unix sockets, which are not supported on this platform.");
+  }
+
+  void ClusterCoordinator::stop()
+  {
+  }
+
+  std::string ClusterClient::request(const std::string& line)
+  {
+    throw DiscordException("Cluster mode needs Unix sockets, which are not supported on this platform.");
+  }
+
+  ClusterClient::ClusterClient(const std::string& path) : m_fd(-1)
+  {
+    LOG(ERROR) << "Cluster mode needs Unix sockets, which are not supported on this platform.";
+    throw DiscordException("Cluster mode needs Unix sockets, which are not supported on this platform.");
+  }
+
+  ClusterClient::~ClusterClient()
+  {
+  }
+#endif
+
+  ShardRange ClusterClient::join(const std::string& name)
+  {
+    if (name.empty() || name.find_first_of(" \n") != std::string::npos)
+    {
+      LOG(ERROR) << "Cluster process names can't be empty or contain spaces: " << name;
+      throw DiscordException("Cluster process names can't be empty or contain spaces: " + name);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::istringstream reply(request("JOIN " + name));
+    std::string command;
+    ShardRange range = { 0, 0, 0 };
+    reply >> command >> range.first >> range.last >> range.total;
+
+    if (command != "RANGE" || range.first >= range.last || range.total <= 0)
+    {
+      LOG(ERROR) << "Could not join the cluster: " << reply.str();
+      throw DiscordException("Could not join the cluster: " + reply.str());
+    }
+
+    return range;
+  }
+
+  std::chrono::milliseconds ClusterClient::identify_delay(int shard, int max_concurrency)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::istringstream reply(request("IDENTIFY " + std::to_string(shard) + " " + std::to_string(max_concurrency)));
+    std::string command;
+    int64_t delay = 0;
+    reply >> command >> delay;
+
+    if (command != "DELAY")
+    {
+      throw DiscordException("Unexpected reply from the cluster coordinator: " + reply.str());
+    }
+
+    return std::chrono::milliseconds(delay);
+  }
+
+  GuildOwner ClusterClient::owner(Snowflake guild_id)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::istringstream reply(request("OWNER " + guild_id.to_string()));
+    std::string command;
+    GuildOwner owner = { 0, "" };
+    reply >> command >> owner.shard >> owner.process;
+
+    if (command != "OWNER")
+    {
+      throw DiscordException("Unexpected reply from the cluster coordinator: " + reply.str());
+    }
+
+    return owner;
+  }
+}
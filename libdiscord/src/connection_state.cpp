@@ -8,10 +8,180 @@
 #include "member.h"
 #include "role.h"
 #include "user.h"
+#include <algorithm>
 #include <iomanip>
+#include <random>
 
 namespace discord
 {
+  struct ConnectionState::RestCall
+  {
+    APIKey key;
+    Snowflake major;
+    HttpRequest request;
+    pplx::task_completion_event<std::shared_ptr<APIResponse>> done;
+
+    /** How many times the request failed with a server error or no response. */
+    uint32_t failures;
+
+    /** How many times the request was rate limited. */
+    uint32_t rate_limits;
+  };
+
+  const uint32_t ConnectionState::MAX_ATTEMPTS = 4;
+  const uint32_t ConnectionState::MAX_RATE_LIMIT_RETRIES = 5;
+  const std::chrono::milliseconds ConnectionState::RETRY_BASE_DELAY = std::chrono::milliseconds(500);
+  const std::chrono::milliseconds ConnectionState::RETRY_MAX_DELAY = std::chrono::milliseconds(16000);
+
+  namespace
+  {
+    /** Reads a header as a number, or returns a fallback if it is missing or malformed. */
+    double header_number(const HttpResponse& res, const std::string& name, double fallback)
+    {
+      auto value = res.header(name);
+
+      if (!value)
+      {
+        return fallback;
+      }
+
+      try
+      {
+        return std::stod(*value);
+      }
+      catch (const std::exception&)
+      {
+        return fallback;
+      }
+    }
+
+    /** Reads the rate limit headers of a response. */
+    RateLimitInfo read_rate_limit(const HttpResponse& res)
+    {
+      RateLimitInfo info;
+
+      if (auto bucket = res.header("x-ratelimit-bucket"))
+      {
+        info.bucket = *bucket;
+      }
+
+      info.limit = static_cast<int32_t>(header_number(res, "x-ratelimit-limit", -1));
+      info.remaining = static_cast<int32_t>(header_number(res, "x-ratelimit-remaining", -1));
+
+      //  Prefer the relative reset, it doesn't depend on our clock agreeing with Discord's.
+      auto reset_after = header_number(res, "x-ratelimit-reset-after", -1);
+
+      if (reset_after < 0)
+      {
+        auto reset = header_number(res, "x-ratelimit-reset", 0);
+        auto now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        reset_after = std::max(0.0, reset - now);
+      }
+
+      info.reset_after = std::chrono::milliseconds(static_cast<int64_t>(reset_after * 1000));
+      info.retry_after = std::chrono::milliseconds(static_cast<int64_t>(header_number(res, "retry-after", 0)));
+      info.global = res.header("x-ratelimit-global") != nullptr;
+
+      return info;
+    }
+
+    /** Checks whether a response is a server error that may go away if the request is sent again. */
+    bool is_transient(const HttpResponse& res, Method method)
+    {
+      switch (res.status_code)
+      {
+      case web::http::status_codes::BadGateway:
+      case web::http::status_codes::ServiceUnavailable:
+      case web::http::status_codes::GatewayTimeout:
+        //  Discord never got the request.
+        return true;
+      case web::http::status_codes::InternalError:
+        //  The request may have gone through, so only retry if sending it twice is harmless.
+        return method != Method::POST;
+      default:
+        return false;
+      }
+    }
+
+    /** Reads the body of a response, throwing the matching exception if it is an error. */
+    std::shared_ptr<APIResponse> read_response(HttpResponse&& res)
+    {
+      if (res.status_code == web::http::status_codes::OK)
+      {
+        LOG(DEBUG) << "Got API response: " << res.body;
+      }
+
+      //  The body moves into the response and is parsed where it lies.
+      auto response = std::make_shared<APIResponse>(res.status_code, res.status_code == web::http::status_codes::NoContent ? std::string() : std::move(res.body));
+
+      if (res.status_code != web::http::status_codes::OK && res.status_code != web::http::status_codes::NoContent)
+      {
+        auto code_member = response->data.FindMember("code");
+
+        if (code_member != response->data.MemberEnd())
+        {
+          //  Try to find a name member which holds error data.
+          auto found = response->data.FindMember("name");
+
+          //  If the name member isn't found, try to find the content member instead.
+          if (found == response->data.MemberEnd())
+          {
+            found = response->data.FindMember("content");
+          }
+
+          //  If we found either name or content, then concatenate their messages and throw an exception.
+          if (found != response->data.MemberEnd())
+          {
+            std::string messages;
+            for (const auto& content : found->value.GetArray())
+            {
+              messages += std::string(content.GetString()) + "\n";
+            }
+
+            if (messages.size() > 0)
+            {
+              throw DiscordException(messages);
+            }
+
+            throw DiscordException("API call failed and response was null.");
+          }
+
+          //  Didn't find name or content member, throw based off error code instead.
+          auto code = code_member->value.GetInt();
+          std::string message = response->data["message"].GetString();
+
+          if (code < 20000)
+          {
+            throw UnknownException(message);
+          }
+
+          if (code < 30000)
+          {
+            throw TooManyException(message);
+          }
+
+          switch (code)
+          {
+          case EmbedDisabled:
+            throw EmbedException(message);
+          case MissingPermissions:
+          case ChannelVerificationTooHigh:
+            throw PermissionException(message);
+          case Unauthorized:
+          case MissingAccess:
+          case InvalidAuthToken:
+            throw AuthorizationException(message);
+          default:
+            //  No specially handled codes left, throw a default exception
+            throw DiscordException(message);
+          }
+        }
+      }
+
+      return response;
+    }
+  }
+
   void ConnectionState::raise_event(EventType type, rapidjson::Value& data) const
   {
     if (m_event_handler)
@@ -20,114 +190,263 @@ namespace discord
     }
   }
 
-  ConnectionState::ConnectionState() : m_shards(0)
+  ConnectionState::ConnectionState() : m_shards(0), m_first_shard(0), m_last_shard(-1), m_encoding(Encoding::JSON), m_max_missed_acks(Gateway::DEFAULT_MAX_MISSED_ACKS),
+    m_large_threshold(Gateway::LARGE_SERVER), m_identify(m_timers), m_member_requester(m_timers), m_rate_limiter(m_timers)
   {
-    m_client = new web::http::client::http_client(U("https://discordapp.com/api/v6"));
+    m_transport = std::make_unique<CpprestTransport>();
   }
 
-  ConnectionState::ConnectionState(std::string token, int shards) : ConnectionState()
+  ConnectionState::ConnectionState(std::string token, int shards, Encoding encoding) : ConnectionState()
   {
     m_token = token;
     m_shards = shards;
+    m_encoding = encoding;
+
+    //  Events that update the cache are always consumed. The ones that are only passed on to the
+    //  Bot are consumed once it has a handler for them.
+    static const DispatchEvent HANDLER_ONLY[] =
+    {
+      DispatchEvent::MessageCreate,
+      DispatchEvent::MessageUpdate,
+      DispatchEvent::MessageDelete,
+      DispatchEvent::MessageDeleteBulk,
+      DispatchEvent::TypingStart
+    };
+
+    for (size_t event = 0; event < DISPATCH_TABLE.size(); ++event)
+    {
+      if (DISPATCH_TABLE[event] && std::find(std::begin(HANDLER_ONLY), std::end(HANDLER_ONLY), static_cast<DispatchEvent>(event)) == std::end(HANDLER_ONLY))
+      {
+        m_filter.consume(static_cast<DispatchEvent>(event));
+      }
+    }
+
+    //  Cached REST routes and how long to keep them. Gateway events drop them sooner when they change.
+    m_cache.set_ttl(User_UID, std::chrono::minutes(5));
+    m_cache.set_ttl(Guild_GID_Mem_UID, std::chrono::minutes(1));
+    m_cache.set_ttl(Guild_GID_Roles, std::chrono::minutes(5));
+    m_cache.set_ttl(Guild_GID_Bans, std::chrono::minutes(1));
+    m_cache.set_ttl(Guild_GID_Regions, std::chrono::hours(1));
+    m_cache.set_ttl(Chan_CID_Pins, std::chrono::minutes(5));
+
+    //  Nothing else is done with pin updates, they are only needed to keep the cache fresh.
+    m_filter.consume(DispatchEvent::ChannelPinsUpdate);
   }
 
   ConnectionState::~ConnectionState()
   {
-    delete m_client;
+    //  Gateways that were never started would be started after they are destroyed.
+    for (auto timer : m_start_timers)
+    {
+      m_timers.cancel(timer);
+    }
+
+    //  Stop timers first so no callback can run while the gateways are being destroyed.
+    m_timers.stop();
+  }
+
+  void ConnectionState::persist_sessions(const std::string& directory)
+  {
+    m_session_directory = directory;
+  }
+
+  void ConnectionState::set_shard_range(int first, int last)
+  {
+    if (m_shards <= 0 || first < 0 || first >= last || last > m_shards)
+    {
+      LOG(ERROR) << "Shard range " << first << " to " << last << " does not fit in " << m_shards << " shards.";
+      throw DiscordException("Shard range " + std::to_string(first) + " to " + std::to_string(last) + " does not fit in " + std::to_string(m_shards) + " shards.");
+    }
+
+    m_first_shard = first;
+    m_last_shard = last;
+  }
+
+  void ConnectionState::join_cluster(const std::string& path, const std::string& name)
+  {
+    m_cluster = std::make_unique<ClusterClient>(path);
+
+    auto range = m_cluster->join(name);
+    m_shards = range.total;
+    set_shard_range(range.first, range.last);
+
+    auto cluster = m_cluster.get();
+    m_identify.set_remote([cluster](int shard, int max_concurrency)
+    {
+      return cluster->identify_delay(shard, max_concurrency);
+    });
+  }
+
+  GuildOwner ConnectionState::guild_owner(Snowflake guild_id)
+  {
+    if (!m_cluster)
+    {
+      LOG(ERROR) << "Tried to find the owner of a guild without joining a cluster.";
+      throw DiscordException("Tried to find the owner of a guild without joining a cluster.");
+    }
+
+    return m_cluster->owner(guild_id);
+  }
+
+  void ConnectionState::set_max_missed_acks(uint32_t max_missed_acks)
+  {
+    m_max_missed_acks = max_missed_acks;
+
+    for (auto& gateway : m_gateways)
+    {
+      gateway->set_max_missed_acks(max_missed_acks);
+    }
+  }
+
+  void ConnectionState::set_large_threshold(uint8_t threshold)
+  {
+    m_large_threshold = threshold;
+
+    for (auto& gateway : m_gateways)
+    {
+      gateway->set_large_threshold(threshold);
+    }
+  }
+
+  pplx::task<uint32_t> ConnectionState::request_members(const std::vector<Snowflake>& guild_ids)
+  {
+    return m_member_requester.request(guild_ids);
+  }
+
+  LatencyStats ConnectionState::latency(int shard) const
+  {
+    auto index = shard - m_first_shard;
+
+    if (index < 0 || index >= static_cast<int>(m_gateways.size()))
+    {
+      throw DiscordException("Shard " + std::to_string(shard) + " is not connected.");
+    }
+
+    return m_gateways[index]->latency();
+  }
+
+  EventFilter& ConnectionState::filter()
+  {
+    return m_filter;
   }
 
   void ConnectionState::connect()
   {
-    int recommended_shards;
+    GatewayInfo info;
     utility::string_t wss_url;
 
     web::uri_builder builder(U(""));
     builder.append_query(U("v"), Gateway::VERSION);
-    builder.append_query(U("encoding"), Gateway::ENCODING);
+    builder.append_query(U("encoding"), m_encoding == Encoding::ETF ? Gateway::ETF_ENCODING : Gateway::JSON_ENCODING);
 
-    if (wss_url.empty())
+    do
     {
-      do
+      try
       {
-        try
-        {
-          //  Attempt to get the Gateway URL.
-          wss_url = utility::conversions::to_string_t(api::get_wss_url(*this, &recommended_shards));
-        }
-        catch (const web::http::http_exception& e)
-        {
-          LOG(ERROR) << "Exception getting gateway URL: " << e.what();
-          LOG(ERROR) << "Sleeping for 5 seconds and trying again.";
-          std::this_thread::sleep_for(std::chrono::seconds(5));
-        }
-      } while (wss_url.empty());  //  Keep trying until we get it.
+        //  Attempt to get the Gateway URL and our session start limits.
+        info = api::get_gateway_bot(*this);
+        wss_url = utility::conversions::to_string_t(info.url);
+      }
+      catch (const std::exception& e)
+      {
+        LOG(ERROR) << "Exception getting gateway URL: " << e.what();
+        LOG(ERROR) << "Sleeping for 5 seconds and trying again.";
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+      }
+    } while (wss_url.empty());  //  Keep trying until we get it.
 
-      wss_url += builder.to_string();
-    }
+    wss_url += builder.to_string();
 
-    //  For each shard, create a gateway.
-    for (auto shard = 0; shard < m_shards; ++shard)
+    if (m_shards <= 0)
     {
-      m_gateways.push_back(std::make_unique<Gateway>(wss_url, m_token, shard, m_shards));
+      m_shards = info.shards;
+      LOG(INFO) << "Using the recommended shard count of " << m_shards << ".";
+    }
 
-      //  Bind this object's on_dispatch method to the gateway callback.
-      m_gateways.back()->on_dispatch(std::bind(&ConnectionState::on_dispatch, this, std::placeholders::_1, std::placeholders::_2));
+    //  Without a range, this process runs every shard.
+    if (m_last_shard < 0)
+    {
+      m_first_shard = 0;
+      m_last_shard = m_shards;
     }
 
-    //  Start all the gateways.
-    for (auto& gateway : m_gateways)
+    if (info.remaining_identifies < m_last_shard - m_first_shard)
     {
-      gateway->start();
+      LOG(WARNING) << "Only " << info.remaining_identifies << " identifies are left for " << m_last_shard - m_first_shard
+        << " shards, some shards will wait " << info.reset_after << "ms for the limit to reset.";
     }
-  }
 
-  pplx::task<APIResponse> ConnectionState::request(APIKey key, Snowflake major, Method type, std::string endpoint, const std::string&& data)
-  {
-    LOG(DEBUG) << "Request: " << endpoint << " - " << major.to_string() << " - " << data;
-    auto map_key = std::hash<std::string>()(std::to_string(key) + major.to_string());
-    auto api_locked = m_api_locks.find(map_key);
+    m_identify.set_limits(info.max_concurrency, info.total_identifies, info.remaining_identifies, std::chrono::milliseconds(info.reset_after));
 
-    //  If the cached mutex does not exist, create it.
-    if (api_locked == std::end(m_api_locks))
+    //  For each shard in our range, create a gateway.
+    for (auto shard = m_first_shard; shard < m_last_shard; ++shard)
     {
-      m_api_locks.emplace(map_key, std::make_unique<std::mutex>());
+      m_gateways.push_back(std::make_unique<Gateway>(m_timers, m_identify, wss_url, m_token, shard, m_shards, m_encoding));
+
+      m_gateways.back()->set_max_missed_acks(m_max_missed_acks);
+      m_gateways.back()->set_filter(&m_filter);
+      m_gateways.back()->set_large_threshold(m_large_threshold);
+
+      if (!m_session_directory.empty())
+      {
+        m_gateways.back()->persist_session(m_session_directory + "/shard_" + std::to_string(shard) + "_of_" + std::to_string(m_shards) + ".session");
+      }
+
+      //  Bind this object's on_dispatch method to the gateway callback.
+      m_gateways.back()->on_dispatch(std::bind(&ConnectionState::on_dispatch, this, std::placeholders::_1, std::placeholders::_2));
+
+      //  GUILD_CREATE is by far the largest payload, so build it straight from the parser.
+      m_gateways.back()->on_guild_create(this, std::bind(&ConnectionState::handle_streamed_guild, this, std::placeholders::_1));
     }
 
-    web::http::method method;
+    m_member_requester.set_sender(m_shards, m_first_shard, m_last_shard, [this](int shard, const std::vector<Snowflake>& guild_ids, const std::string& nonce)
+    {
+      m_gateways[shard - m_first_shard]->request_members(guild_ids, nonce);
+    });
 
-    switch (type)
+    //  Start the gateways one round of identify buckets at a time. Every bucket in a round can identify
+    //  at once, and starting later rounds later keeps their connections from idling until their turn.
+    for (size_t index = 0; index < m_gateways.size(); ++index)
     {
-    case Method::GET:
-      method = web::http::methods::GET;
-      break;
-    case Method::POST:
-      method = web::http::methods::POST;
-      break;
-    case Method::PUT:
-      method = web::http::methods::PUT;
-      break;
-    case Method::PATCH:
-      method = web::http::methods::PATCH;
-      break;
-    case Method::DEL:
-      method = web::http::methods::DEL;
-      break;
+      auto gateway = m_gateways[index].get();
+      auto round = static_cast<int>(index) / m_identify.max_concurrency();
+
+      if (round == 0)
+      {
+        gateway->start();
+      }
+      else
+      {
+        m_start_timers.push_back(m_timers.schedule(IdentifyScheduler::IDENTIFY_INTERVAL * round, [gateway]()
+        {
+          gateway->start();
+        }));
+      }
     }
+  }
+
+  pplx::task<std::shared_ptr<APIResponse>> ConnectionState::request(APIKey key, Snowflake major, Method type, std::string endpoint, const std::string&& data)
+  {
+    LOG(DEBUG) << "Request: " << endpoint << " - " << major.to_string() << " - " << data;
 
-    web::http::http_request request(method);
-    request.set_request_uri(utility::conversions::to_string_t(endpoint));
-    request.headers().add(U("Authorization"), utility::conversions::to_string_t(m_token));
-    request.headers().add(U("Content-Type"), U("application/json"));
+    auto call = std::make_shared<RestCall>();
+    call->key = key;
+    call->major = major;
+    call->request.method = type;
+    call->request.path = endpoint;
+    call->request.authorization = m_token;
+    call->failures = 0;
+    call->rate_limits = 0;
 
     if (!data.empty())
     {
       //  If there's data and the method is GET, then add data as query parameters.
-      if (method == web::http::methods::GET)
+      if (type == Method::GET)
       {
         LOG(DEBUG) << "Setting query parameters: " << (endpoint + data);
         try
         {
-          request.set_request_uri(utility::conversions::to_string_t(endpoint + "?" + data));
+          call->request.path = utility::conversions::to_utf8string(web::uri(utility::conversions::to_string_t(endpoint + "?" + data)).to_string());
         }
         catch (const std::exception&)
         {
@@ -137,469 +456,647 @@ namespace discord
       else
       {
         LOG(DEBUG) << "Setting request data.";
-        request.set_body(data);
+        call->request.body = data;
       }
     }
 
-    return pplx::create_task([=]() {
-      std::unique_lock<std::mutex> api_lock(*m_api_locks[map_key].get());
+    auto cached = type == Method::GET && m_cache.cacheable(key);
+    uint64_t generation = 0;
 
-      //  Wait until this endpoint is unlocked.
-      if (m_global_mutex.try_lock())
-      {
-        m_global_mutex.unlock();
-      }
-      else
-      {
-        //  If we can't lock the global mutex, then we might be rate limited.
-        //  Wait for the global mutex to become available again before continuing.
-        LOG(DEBUG) << "Could not lock global mutex. Waiting for it to unlock.";
-        std::unique_lock<std::mutex> global_lock(m_global_mutex);
-        LOG(DEBUG) << "Global mutex unlocked.";
-      }
+    if (cached)
+    {
+      auto response = m_cache.find(call->request.path);
 
-      return m_client->request(request).then([&](web::http::http_response res) -> APIResponse
+      if (response)
       {
-        APIResponse response;
-        auto headers = res.headers();
+        LOG(DEBUG) << "Using the cached response for " << call->request.path;
+        return pplx::task_from_result(response);
+      }
 
-        //  Various rate-limit related headers
-        auto remaining = headers.find(U("X-RateLimit-Remaining"));
-        auto reset = headers.find(U("X-RateLimit-Reset"));
-        auto retry = headers.find(U("Retry-After"));
-        auto global = headers.find(U("X-RateLimit-Global"));
-        auto date_str = headers.find(U("Date"));
-        auto server_date = std::chrono::system_clock::now();
+      //  Taken before sending, so an invalidation while the request is in flight keeps it out of the cache.
+      generation = m_cache.generation();
+    }
 
-        if (date_str != std::end(headers))
-        {
-          std::tm tm = {};
-          std::stringstream ss(utility::conversions::to_utf8string(date_str->second));
-          ss >> std::get_time(&tm, "%b %d %Y %H:%M:%S");
-          server_date = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-        }
+    if (type == Method::GET)
+    {
+      std::lock_guard<std::mutex> lock(m_gets_mutex);
+      auto pending = m_pending_gets.find(call->request.path);
 
-        if (remaining != std::end(headers))
-        {
-          auto rate_remaining = std::stoul(utility::conversions::to_utf8string(remaining->second));
+      //  The same GET is already in flight, share its response instead of spending the rate limit again.
+      if (pending != std::end(m_pending_gets))
+      {
+        LOG(DEBUG) << "Joining the GET already in flight for " << call->request.path;
+        pplx::task_completion_event<std::shared_ptr<APIResponse>> shared;
+        pending->second.push_back(shared);
+        return pplx::create_task(shared);
+      }
 
-          if (!rate_remaining)
-          {
-            auto rate_reset = std::stoul(utility::conversions::to_utf8string(reset->second));
+      m_pending_gets[call->request.path];
+    }
 
-            //  Get the time that the rate limit will reset.
-            auto end_time = std::chrono::system_clock::time_point(std::chrono::seconds(rate_reset));
+    send_request(call);
+    auto task = pplx::create_task(call->done);
 
-            //  Get the total amount of time to wait from this point.
-            auto total_time = std::chrono::duration_cast<std::chrono::seconds>(end_time - std::chrono::system_clock::now()).count();
+    if (type == Method::GET)
+    {
+      task.then([this, key, major, cached, generation, path = call->request.path](pplx::task<std::shared_ptr<APIResponse>> result)
+      {
+        std::vector<pplx::task_completion_event<std::shared_ptr<APIResponse>>> waiting;
 
-            LOG(WARNING) << "We hit the rate limit for endpoint " << endpoint << ". Sleeping for " << total_time << " seconds.";
-            std::this_thread::sleep_until(end_time);
-          }
+        {
+          std::lock_guard<std::mutex> lock(m_gets_mutex);
+          auto pending = m_pending_gets.find(path);
+          waiting = std::move(pending->second);
+          m_pending_gets.erase(pending);
         }
 
-        if (retry != std::end(headers))
+        try
         {
-          auto retry_after = std::stoul(utility::conversions::to_utf8string(retry->second));
+          auto response = result.get();
 
-          if (global == std::end(headers))
+          if (cached && response->status_code == web::http::status_codes::OK)
           {
-            LOG(WARNING) << "Received a Retry-After header. Waiting for " << retry_after << "ms.";
-            std::this_thread::sleep_for(std::chrono::milliseconds(retry_after));
-            api_lock.release()->unlock();
-            this->request(key, major, type, endpoint, std::move(data));
+            m_cache.store(key, major, path, response, generation);
           }
-          else
-          {
-            LOG(ERROR) << "Hit the global rate limit. Waiting for " << retry_after << "ms.";
 
-            //  This is a global rate limit, lock the global mutex and wait.
-            std::lock_guard<std::mutex> global_lock(m_global_mutex);
-            std::this_thread::sleep_for(std::chrono::milliseconds(retry_after));
+          for (auto& event : waiting)
+          {
+            event.set(response);
           }
         }
-
-        response.status_code = res.status_code();
-
-        if (res.status_code() == web::http::status_codes::OK)
+        catch (...)
         {
-          auto bodyStream = res.body();
-          Concurrency::streams::container_buffer<std::string> inStringBuffer;
-
-          bodyStream.read_to_end(inStringBuffer).then([inStringBuffer](size_t bytesRead)
+          for (auto& event : waiting)
           {
-            return inStringBuffer.collection();
-          }).then([&response](std::string text)
-          {
-            LOG(DEBUG) << "Got API response: " << text;
-            response.data.Parse(text.c_str(), text.size());
-          }).get();
+            event.set_exception(std::current_exception());
+          }
         }
-        else if (res.status_code() != web::http::status_codes::NoContent)
-        {
-          auto json_str = utility::conversions::to_utf8string(res.extract_string().get());
-          response.data.Parse(json_str.c_str(), json_str.size());
-
-          auto code_member = response.data.FindMember("code");
+      });
+    }
 
-          if (code_member != response.data.MemberEnd())
-          {
-            //  Try to find a name member which holds error data.
-            auto found = response.data.FindMember("name");
+    return task;
+  }
 
-            //  If the name member isn't found, try to find the content member instead.
-            if (found == response.data.MemberEnd())
-            {
-              found = response.data.FindMember("content");
-            }
+  ResponseCache& ConnectionState::response_cache()
+  {
+    return m_cache;
+  }
 
-            //  If we found either name or content, then concatenate their messages and throw an exception.
-            if (found != response.data.MemberEnd())
-            {
-              std::string messages;
-              for (const auto& content : found->value.GetArray())
-              {
-                messages += std::string(content.GetString()) + "\n";
-              }
-
-              if (messages.size() > 0)
-              {
-                throw DiscordException(messages);
-              }
-
-              throw DiscordException("API call failed and response was null.");
-            }
+  RateLimiter& ConnectionState::rate_limiter()
+  {
+    return m_rate_limiter;
+  }
 
-            //  Didn't find name or content member, throw based off error code instead.
-            auto code = code_member->value.GetInt();
-            std::string message = response.data["message"].GetString();
+  void ConnectionState::set_http_transport(std::unique_ptr<HttpTransport> transport)
+  {
+    m_transport = std::move(transport);
+  }
 
-            if (code < 20000)
-            {
-              throw UnknownException(message);
-            }
+  void ConnectionState::retry_request(std::shared_ptr<RestCall> call, const std::string& reason)
+  {
+    m_breaker.record_failure(call->key);
 
-            if (code < 30000)
-            {
-              throw TooManyException(message);
-            }
+    if (++call->failures >= MAX_ATTEMPTS)
+    {
+      LOG(ERROR) << "Giving up on REST request to " << call->request.path << ": " << reason;
+      call->done.set_exception(DiscordException("REST request to " + call->request.path + " failed: " + reason));
+      return;
+    }
 
-            switch (code)
-            {
-            case EmbedDisabled:
-              throw EmbedException(message);
-            case MissingPermissions:
-            case ChannelVerificationTooHigh:
-              throw PermissionException(message);
-            case Unauthorized:
-            case MissingAccess:
-            case InvalidAuthToken:
-              throw AuthorizationException(message);
-            default:
-              //  No specially handled codes left, throw a default exception
-              throw DiscordException(message);
-            }
-          }
-        }
+    //  Wait somewhere between half and all of the backoff, so requests that failed together don't retry together.
+    static thread_local std::mt19937 engine(std::random_device{}());
+    auto backoff = std::min(RETRY_BASE_DELAY * (1 << std::min<uint32_t>(call->failures - 1, 16)), RETRY_MAX_DELAY);
+    std::uniform_int_distribution<int64_t> distribution(backoff.count() / 2, backoff.count());
+    auto delay = std::chrono::milliseconds(distribution(engine));
 
-        return response;
-      }).get();
-    });
+    LOG(WARNING) << "REST request to " << call->request.path << " failed: " << reason << ". Retrying in " << delay.count() << "ms.";
+    m_timers.schedule(delay, [this, call]() { send_request(call); });
   }
 
-  void ConnectionState::on_dispatch(std::string event_name, rapidjson::Value& data)
+  void ConnectionState::send_request(std::shared_ptr<RestCall> call)
   {
-    //LOG(INFO) << "Bot.handle_dispatch entered with " << event_name.c_str() << ".";
+    if (!m_breaker.allow(call->key))
+    {
+      call->done.set_exception(DiscordException("REST request to " + call->request.path + " failed: Discord is failing requests to this route."));
+      return;
+    }
 
-    if (event_name == "READY")
+    //  Nothing here blocks. A request that has to wait sits in its bucket until a timer releases it.
+    m_rate_limiter.acquire(call->key, call->major, [this, call]()
     {
-      m_profile = std::make_unique<User>(this, data["user"]);
+      pplx::task<HttpResponse> sent;
 
-      for (auto& channel_data : data["private_channels"].GetArray())
+      try
       {
-        Snowflake id(channel_data["id"].GetString());
-        Channel chan(this, channel_data);
-        m_private_channels[id] = chan;
+        sent = m_transport->send(call->request);
+      }
+      catch (const std::exception& e)
+      {
+        //  Nothing was sent, so it is always safe to try again.
+        m_rate_limiter.complete(call->key, call->major, RateLimitInfo());
+        retry_request(call, std::string("could not send it, ") + e.what());
+        return;
       }
 
-      //  Pass dummy to avoid compatibility problems with default values for references
-      rapidjson::Value dummy;
-      raise_event(Ready, dummy);
-    }
-    else if (event_name == "CHANNEL_CREATE")
-    {
-      Channel chan(this, data);
-      auto found = data.FindMember("guild_id");
-      if (found != data.MemberEnd() && !found->value.IsNull())
+      sent.then([this, call](pplx::task<HttpResponse> task)
       {
-        //  This is a Guild Channel object, add it to its respective guild.
-        auto guild_id = Snowflake(data["guild_id"].GetString());
+        HttpResponse res;
 
-        m_channel_guilds[chan.id()] = guild_id;
+        try
+        {
+          res = task.get();
+        }
+        catch (const std::exception& e)
+        {
+          m_rate_limiter.complete(call->key, call->major, RateLimitInfo());
 
-        auto owner = m_guilds.find(guild_id);
+          //  A POST may have gone through before the connection failed, so it is never sent twice.
+          if (call->request.method == Method::POST)
+          {
+            call->failures = MAX_ATTEMPTS;
+          }
 
-        if (owner == std::end(m_guilds))
-        {
-          LOG(ERROR) << "Tried to add a channel from a non-existent guild.";
+          retry_request(call, std::string("no response, ") + e.what());
+          return;
         }
-        else
+
+        auto info = read_rate_limit(res);
+        m_rate_limiter.complete(call->key, call->major, info);
+
+        if (is_transient(res, call->request.method))
         {
-          owner->second.add_channel(chan);
+          retry_request(call, "status " + std::to_string(res.status_code));
+          return;
         }
-      }
-      else
-      {
-        //  This is a DM channel object. Add it to the Bot's private channels.
-        m_private_channels[chan.id()] = chan;
-      }
-    }
-    else if (event_name == "CHANNEL_UPDATE")
-    {
-      Channel chan(this, data);
-      auto found = data.FindMember("guild_id");
-      if (found != data.MemberEnd() && !found->value.IsNull())
-      {
-        //  This is a Guild Channel object, update it inside its respective guild.
-        auto guild_id = Snowflake(data["guild_id"].GetString());
 
-        m_channel_guilds[chan.id()] = guild_id;
+        m_breaker.record_success(call->key);
+
+        if (res.status_code == web::http::status_codes::TooManyRequests)
+        {
+          if (++call->rate_limits > MAX_RATE_LIMIT_RETRIES)
+          {
+            LOG(ERROR) << "Giving up on REST request to " << call->request.path << " after it was rate limited " << MAX_RATE_LIMIT_RETRIES << " times.";
+            call->done.set_exception(DiscordException("REST request to " + call->request.path + " kept being rate limited."));
+            return;
+          }
+
+          if (info.global)
+          {
+            LOG(ERROR) << "Hit the global rate limit. Waiting for " << info.retry_after.count() << "ms.";
+          }
+          else
+          {
+            LOG(WARNING) << "Rate limited on " << call->request.path << ". Retrying in " << info.retry_after.count() << "ms.";
+          }
 
-        auto owner = m_guilds.find(guild_id);
+          //  The bucket now knows to hold this back until the limit resets.
+          send_request(call);
+          return;
+        }
 
-        if (owner == std::end(m_guilds))
+        try
         {
-          LOG(ERROR) << "Tried to add a channel from a non-existent guild.";
+          call->done.set(read_response(std::move(res)));
         }
-        else
+        catch (...)
         {
-          owner->second.update_channel(chan);
+          call->done.set_exception(std::current_exception());
         }
-      }
-      else
-      {
-        //  This is a DM channel object. Update it in the private channels list.
-        m_private_channels[chan.id()] = chan;
-      }
+      });
+    });
+  }
+
+  ConnectionState::DispatchTable ConnectionState::build_dispatch_table()
+  {
+    DispatchTable table = {};
+
+    table[static_cast<size_t>(DispatchEvent::Ready)] = &ConnectionState::handle_ready;
+    table[static_cast<size_t>(DispatchEvent::ChannelCreate)] = &ConnectionState::handle_channel_create;
+    table[static_cast<size_t>(DispatchEvent::ChannelUpdate)] = &ConnectionState::handle_channel_update;
+    table[static_cast<size_t>(DispatchEvent::ChannelDelete)] = &ConnectionState::handle_channel_delete;
+    table[static_cast<size_t>(DispatchEvent::GuildCreate)] = &ConnectionState::handle_guild_create;
+    table[static_cast<size_t>(DispatchEvent::GuildUpdate)] = &ConnectionState::handle_guild_update;
+    table[static_cast<size_t>(DispatchEvent::GuildDelete)] = &ConnectionState::handle_guild_delete;
+    table[static_cast<size_t>(DispatchEvent::GuildBanAdd)] = &ConnectionState::handle_guild_ban_add;
+    table[static_cast<size_t>(DispatchEvent::GuildBanRemove)] = &ConnectionState::handle_guild_ban_remove;
+    table[static_cast<size_t>(DispatchEvent::GuildEmojisUpdate)] = &ConnectionState::handle_guild_emojis_update;
+    table[static_cast<size_t>(DispatchEvent::GuildIntegrationsUpdate)] = &ConnectionState::handle_guild_integrations_update;
+    table[static_cast<size_t>(DispatchEvent::GuildMemberAdd)] = &ConnectionState::handle_guild_member_add;
+    table[static_cast<size_t>(DispatchEvent::GuildMemberRemove)] = &ConnectionState::handle_guild_member_remove;
+    table[static_cast<size_t>(DispatchEvent::GuildMemberUpdate)] = &ConnectionState::handle_guild_member_update;
+    table[static_cast<size_t>(DispatchEvent::GuildMembersChunk)] = &ConnectionState::handle_guild_members_chunk;
+    table[static_cast<size_t>(DispatchEvent::GuildRoleCreate)] = &ConnectionState::handle_guild_role_create;
+    table[static_cast<size_t>(DispatchEvent::GuildRoleUpdate)] = &ConnectionState::handle_guild_role_update;
+    table[static_cast<size_t>(DispatchEvent::GuildRoleDelete)] = &ConnectionState::handle_guild_role_delete;
+    table[static_cast<size_t>(DispatchEvent::MessageCreate)] = &ConnectionState::handle_message_create;
+    table[static_cast<size_t>(DispatchEvent::MessageUpdate)] = &ConnectionState::handle_message_update;
+    table[static_cast<size_t>(DispatchEvent::MessageDelete)] = &ConnectionState::handle_message_delete;
+    table[static_cast<size_t>(DispatchEvent::MessageDeleteBulk)] = &ConnectionState::handle_message_delete_bulk;
+    table[static_cast<size_t>(DispatchEvent::PresenceUpdate)] = &ConnectionState::handle_presence_update;
+    table[static_cast<size_t>(DispatchEvent::TypingStart)] = &ConnectionState::handle_typing_start;
+
+    return table;
+  }
+
+  const ConnectionState::DispatchTable ConnectionState::DISPATCH_TABLE = ConnectionState::build_dispatch_table();
+
+  void ConnectionState::handle_ready(rapidjson::Value& data)
+  {
+    m_profile = std::make_unique<User>(this, data["user"]);
+
+    for (auto& channel_data : data["private_channels"].GetArray())
+    {
+      Snowflake id(channel_data["id"]);
+      Channel chan(this, channel_data);
+      m_private_channels[id] = chan;
     }
-    else if (event_name == "CHANNEL_DELETE")
+
+    //  Pass dummy to avoid compatibility problems with default values for references
+    rapidjson::Value dummy;
+    raise_event(Ready, dummy);
+  }
+
+  void ConnectionState::handle_channel_create(rapidjson::Value& data)
+  {
+    Channel chan(this, data);
+    auto found = data.FindMember("guild_id");
+    if (found != data.MemberEnd() && !found->value.IsNull())
     {
-      Channel chan(this, data);
-      auto found = data.FindMember("guild_id");
-      if (found != data.MemberEnd() && !found->value.IsNull())
-      {
-        //  This is a Guild Channel object, remove it from its respective guild.
-        auto guild_id = Snowflake(data["guild_id"].GetString());
+      //  This is a Guild Channel object, add it to its respective guild.
+      auto guild_id = Snowflake(data["guild_id"]);
 
-        m_channel_guilds.erase(chan.id());
+      m_channel_guilds[chan.id()] = guild_id;
 
-        auto owner = m_guilds.find(guild_id);
+      auto owner = m_guilds.find(guild_id);
 
-        if (owner == std::end(m_guilds))
-        {
-          LOG(ERROR) << "Tried to remove a channel from a non-existent guild.";
-        }
-        else
-        {
-          owner->second.remove_channel(chan);
-        }
+      if (owner == std::end(m_guilds))
+      {
+        LOG(ERROR) << "Tried to add a channel from a non-existent guild.";
       }
       else
       {
-        //  This is a DM channel object. Remove it from the private channels list.
-        m_private_channels.erase(chan.id());
+        owner->second.add_channel(chan);
       }
     }
-    else if (event_name == "GUILD_CREATE")
-    {
-      Guild new_guild(this, data);
-      m_guilds[new_guild.id()] = new_guild;
-	  raise_event(GuildCreated, data);
-    }
-    else if (event_name == "GUILD_UPDATE")
+    else
     {
-      Guild updated(this, data);
-      m_guilds[updated.id()] = updated;
+      //  This is a DM channel object. Add it to the Bot's private channels.
+      m_private_channels[chan.id()] = chan;
     }
-    else if (event_name == "GUILD_DELETE")
+  }
+
+  void ConnectionState::handle_channel_update(rapidjson::Value& data)
+  {
+    Channel chan(this, data);
+    auto found = data.FindMember("guild_id");
+    if (found != data.MemberEnd() && !found->value.IsNull())
     {
-      Snowflake id(data["id"].GetString());
+      //  This is a Guild Channel object, update it inside its respective guild.
+      auto guild_id = Snowflake(data["guild_id"]);
+
+      m_channel_guilds[chan.id()] = guild_id;
 
-      if (data.FindMember("unavailable") != data.MemberEnd())
+      auto owner = m_guilds.find(guild_id);
+
+      if (owner == std::end(m_guilds))
       {
-        m_guilds[id].set_unavailable(true);
+        LOG(ERROR) << "Tried to add a channel from a non-existent guild.";
       }
       else
       {
-        auto guild = m_guilds.at(id);
-        auto channel_ids = guild.channel_ids();
-
-        for (const auto& chan_id : channel_ids)
-        {
-          m_channel_guilds.erase(chan_id);
-        }
-
-        m_guilds.erase(id);
+        owner->second.update_channel(chan);
       }
     }
-    else if (event_name == "GUILD_BAN_ADD")
+    else
     {
-      User banned(this, data["user"]);
-      Snowflake guild_id(data["guild_id"].GetString());
-
-      LOG(DEBUG) << "User " << banned.distinct()
-        << " has been banned from "
-        << m_guilds[guild_id].name() << ".";
+      //  This is a DM channel object. Update it in the private channels list.
+      m_private_channels[chan.id()] = chan;
     }
-    else if (event_name == "GUILD_BAN_REMOVE")
-    {
-      User unbanned(this, data["user"]);
-      Snowflake guild_id(data["guild_id"].GetString());
-      LOG(DEBUG) << "User " << unbanned.distinct()
-        << " has been unbanned from "
-        << m_guilds[guild_id].name();
-    }
-    else if (event_name == "GUILD_EMOJIS_UPDATE")
+  }
+
+  void ConnectionState::handle_channel_delete(rapidjson::Value& data)
+  {
+    Channel chan(this, data);
+    auto found = data.FindMember("guild_id");
+    if (found != data.MemberEnd() && !found->value.IsNull())
     {
-      //  Update emoji data for the guild
-      Snowflake guild_id(data["guild_id"].GetString());
-      auto owner = m_guilds[guild_id];
+      //  This is a Guild Channel object, remove it from its respective guild.
+      auto guild_id = Snowflake(data["guild_id"]);
 
-      std::vector<Emoji> new_emojis;
-      std::vector<Emoji> deleted_emojis;
-      auto old_emojis = owner.emojis();
+      m_channel_guilds.erase(chan.id());
 
-      for (auto& emoji_data : data["emojis"].GetArray())
-      {
-        Emoji emo(emoji_data);
-		Emoji found;
-        new_emojis.push_back(emo);
+      auto owner = m_guilds.find(guild_id);
 
-        if (owner.find_emoji(emo.id(), found))
-        {
-          //  If emoji was already there, check if it has been updated.
-          if (emo.name() != found.name() || emo.roles() != found.roles())
-          {
-            raise_event(EmojiEdited, emoji_data);
-          }
-        }
-        else
-        {
-          //  Emoji was not found in guild, so raise a new emoji event.
-          raise_event(EmojiCreated, emoji_data);
-        }
+      if (owner == std::end(m_guilds))
+      {
+        LOG(ERROR) << "Tried to remove a channel from a non-existent guild.";
+      }
+      else
+      {
+        owner->second.remove_channel(chan);
       }
-
-      owner.set_emojis(new_emojis);
     }
-    else if (event_name == "GUILD_INTEGRATIONS_UPDATE")
+    else
     {
-      LOG(DEBUG) << "Got a Guild Integrations Update, but left it unhandled.";
+      //  This is a DM channel object. Remove it from the private channels list.
+      m_private_channels.erase(chan.id());
     }
-    else if (event_name == "GUILD_MEMBER_ADD")
+  }
+
+  void ConnectionState::handle_guild_create(rapidjson::Value& data)
+  {
+    Guild new_guild(this, data);
+    add_guild(new_guild);
+  }
+
+  void ConnectionState::handle_guild_update(rapidjson::Value& data)
+  {
+    Guild updated(this, data);
+    m_guilds[updated.id()] = updated;
+  }
+
+  void ConnectionState::handle_guild_delete(rapidjson::Value& data)
+  {
+    Snowflake id(data["id"]);
+
+    if (data.FindMember("unavailable") != data.MemberEnd())
     {
-      Snowflake guild_id(data["guild_id"].GetString());
-      Member guild_member(this, data);
-      m_guilds[guild_id].add_member(guild_member);
+      m_guilds[id].set_unavailable(true);
     }
-    else if (event_name == "GUILD_MEMBER_REMOVE")
+    else
     {
-      Snowflake guild_id(data["guild_id"].GetString());
-      Member guild_member(this, data);
-      m_guilds[guild_id].remove_member(guild_member);
+      auto guild = m_guilds.at(id);
+      auto channel_ids = guild.channel_ids();
+
+      for (const auto& chan_id : channel_ids)
+      {
+        m_channel_guilds.erase(chan_id);
+      }
+
+      m_guilds.erase(id);
     }
-    else if (event_name == "GUILD_MEMBER_UPDATE")
-    {
-      Snowflake guild_id(data["guild_id"].GetString());
+  }
 
-      std::vector<Snowflake> roles;
-      std::string nick;
-      User updated_user;
+  void ConnectionState::handle_guild_ban_add(rapidjson::Value& data)
+  {
+    User banned(this, data["user"]);
+    Snowflake guild_id(data["guild_id"]);
 
-      set_from_json(nick, "nick", data);
+    LOG(DEBUG) << "User " << banned.distinct()
+      << " has been banned from "
+      << m_guilds[guild_id].name() << ".";
+  }
 
-      auto found = data.FindMember("user");
-      if (found != data.MemberEnd() && !found->value.IsNull())
-      {
-        updated_user = User(this, data["user"]);
-      }
+  void ConnectionState::handle_guild_ban_remove(rapidjson::Value& data)
+  {
+    User unbanned(this, data["user"]);
+    Snowflake guild_id(data["guild_id"]);
+    LOG(DEBUG) << "User " << unbanned.distinct()
+      << " has been unbanned from "
+      << m_guilds[guild_id].name();
+  }
+
+  void ConnectionState::handle_guild_emojis_update(rapidjson::Value& data)
+  {
+    //  Update emoji data for the guild
+    Snowflake guild_id(data["guild_id"]);
+    auto owner = m_guilds[guild_id];
+
+    std::vector<Emoji> new_emojis;
+    std::vector<Emoji> deleted_emojis;
+    auto old_emojis = owner.emojis();
+
+    for (auto& emoji_data : data["emojis"].GetArray())
+    {
+      Emoji emo(emoji_data);
+		Emoji found;
+      new_emojis.push_back(emo);
 
-      found = data.FindMember("roles");
-      if (found != data.MemberEnd() && !found->value.IsNull())
+      if (owner.find_emoji(emo.id(), found))
       {
-        for (const auto& role_id : found->value.GetArray())
+        //  If emoji was already there, check if it has been updated.
+        if (emo.name() != found.name() || emo.roles() != found.roles())
         {
-          roles.emplace_back(role_id.GetString());
+          raise_event(EmojiEdited, emoji_data);
         }
       }
-
-      m_guilds[guild_id].update_member(roles, updated_user, nick);
-    }
-    else if (event_name == "GUILD_MEMBERS_CHUNK")
-    {
-      Snowflake guild_id(data["guild_id"].GetString());
-      auto owner = m_guilds[guild_id];
-
-      for (auto& member_data : data["members"].GetArray())
+      else
       {
-        Member guild_member(this, member_data);
-        owner.add_member(guild_member);
+        //  Emoji was not found in guild, so raise a new emoji event.
+        raise_event(EmojiCreated, emoji_data);
       }
     }
-    else if (event_name == "GUILD_ROLE_CREATE")
+
+    owner.set_emojis(new_emojis);
+  }
+
+  void ConnectionState::handle_guild_integrations_update(rapidjson::Value& data)
+  {
+    LOG(DEBUG) << "Got a Guild Integrations Update, but left it unhandled.";
+  }
+
+  void ConnectionState::handle_guild_member_add(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    Member guild_member(this, data);
+    m_guilds[guild_id].add_member(guild_member);
+  }
+
+  void ConnectionState::handle_guild_member_remove(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    Member guild_member(this, data);
+    m_guilds[guild_id].remove_member(guild_member);
+  }
+
+  void ConnectionState::handle_guild_member_update(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+
+    std::vector<Snowflake> roles;
+    std::string nick;
+    User updated_user;
+
+    set_from_json(nick, "nick", data);
+
+    auto found = data.FindMember("user");
+    if (found != data.MemberEnd() && !found->value.IsNull())
     {
-      Snowflake guild_id(data["guild_id"].GetString());
-      Role guild_role(data["role"]);
-      m_guilds[guild_id].add_role(guild_role);
+      updated_user = User(this, data["user"]);
     }
-    else if (event_name == "GUILD_ROLE_UPDATE")
+
+    found = data.FindMember("roles");
+    if (found != data.MemberEnd() && !found->value.IsNull())
     {
-      Snowflake guild_id(data["guild_id"].GetString());
-      Role guild_role(data["role"]);
-      m_guilds[guild_id].update_role(guild_role);
+      for (const auto& role_id : found->value.GetArray())
+      {
+        roles.emplace_back(role_id);
+      }
     }
-    else if (event_name == "GUILD_ROLE_DELETE")
+
+    m_guilds[guild_id].update_member(roles, updated_user, nick);
+  }
+
+  void ConnectionState::handle_guild_members_chunk(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    auto& owner = m_guilds[guild_id];
+    auto& members = data["members"];
+
+    for (auto& member_data : members.GetArray())
     {
-      Snowflake guild_id(data["guild_id"].GetString());
-      Snowflake guild_role(data["role_id"].GetString());
-      m_guilds[guild_id].remove_role(guild_role);
+      Member guild_member(this, member_data);
+      owner.add_member(guild_member);
     }
-    else if (event_name == "MESSAGE_CREATE")
+
+    //  Chunks with a nonce answer a request_members call.
+    auto found = data.FindMember("nonce");
+    if (found != data.MemberEnd() && found->value.IsString())
     {
-      raise_event(MessageCreated, data);
+      uint32_t chunk_count = 1;
+      set_from_json(chunk_count, "chunk_count", data);
+      m_member_requester.on_chunk(guild_id, found->value.GetString(), chunk_count, members.Size());
     }
-    else if (event_name == "MESSAGE_UPDATE")
+  }
+
+  void ConnectionState::handle_guild_role_create(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    Role guild_role(data["role"]);
+    m_guilds[guild_id].add_role(guild_role);
+  }
+
+  void ConnectionState::handle_guild_role_update(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    Role guild_role(data["role"]);
+    m_guilds[guild_id].update_role(guild_role);
+  }
+
+  void ConnectionState::handle_guild_role_delete(rapidjson::Value& data)
+  {
+    Snowflake guild_id(data["guild_id"]);
+    Snowflake guild_role(data["role_id"]);
+    m_guilds[guild_id].remove_role(guild_role);
+  }
+
+  void ConnectionState::handle_message_create(rapidjson::Value& data)
+  {
+    raise_event(MessageCreated, data);
+  }
+
+  void ConnectionState::handle_message_update(rapidjson::Value& data)
+  {
+    raise_event(MessageEdited, data);
+  }
+
+  void ConnectionState::handle_message_delete(rapidjson::Value& data)
+  {
+    raise_event(MessageDeleted, data);
+  }
+
+  void ConnectionState::handle_message_delete_bulk(rapidjson::Value& data)
+  {
+    raise_event(MessagesBulkDeleted, data);
+  }
+
+  void ConnectionState::handle_presence_update(rapidjson::Value& data)
+  {
+    Presence presence(this, data);
+    Snowflake guild_id(data["guild_id"]);
+
+    m_guilds[guild_id].update_presence(presence);
+
+    raise_event(PresenceUpdate, data);
+  }
+
+  void ConnectionState::handle_typing_start(rapidjson::Value& data)
+  {
+    raise_event(Typing, data);
+  }
+
+  void ConnectionState::handle_streamed_guild(Guild& guild)
+  {
+    //  A guild built from a document does this itself as it reads its channels.
+    for (const auto& chan_id : guild.channel_ids())
     {
-      raise_event(MessageEdited, data);
+      cache_channel_id(guild.id(), chan_id);
     }
-    else if (event_name == "MESSAGE_DELETE")
+
+    add_guild(guild);
+  }
+
+  void ConnectionState::add_guild(Guild& guild)
+  {
+    auto id = guild.id();
+    auto& cached = m_guilds[id] = std::move(guild);
+
+    if (m_guild_created_handler)
     {
-      raise_event(MessageDeleted, data);
+      m_guild_created_handler(cached);
     }
-    else if (event_name == "MESSAGE_DELETE_BULK")
+  }
+
+  void ConnectionState::invalidate_cache(DispatchEvent event, rapidjson::Value& data)
+  {
+    //  The id of the user the event is about, or empty if there is none.
+    auto user_id = [&data]() -> std::string
     {
-      raise_event(MessagesBulkDeleted, data);
-    }
-    else if (event_name == "PRESENCE_UPDATE")
+      auto user = data.FindMember("user");
+      return user != data.MemberEnd() && user->value.IsObject() && user->value.HasMember("id") ? Snowflake(user->value["id"]).to_string() : "";
+    };
+
+    switch (event)
     {
-      Presence presence(this, data);
-      Snowflake guild_id(data["guild_id"].GetString());
+    case DispatchEvent::GuildRoleCreate:
+    case DispatchEvent::GuildRoleUpdate:
+    case DispatchEvent::GuildRoleDelete:
+      m_cache.invalidate(Guild_GID_Roles, Snowflake(data["guild_id"]));
+      break;
+    case DispatchEvent::GuildBanAdd:
+    case DispatchEvent::GuildBanRemove:
+      m_cache.invalidate(Guild_GID_Bans, Snowflake(data["guild_id"]));
+      break;
+    case DispatchEvent::ChannelPinsUpdate:
+      m_cache.invalidate(Chan_CID_Pins, Snowflake(data["channel_id"]));
+      break;
+    case DispatchEvent::GuildMemberAdd:
+    case DispatchEvent::GuildMemberRemove:
+    case DispatchEvent::GuildMemberUpdate:
+      {
+        auto id = user_id();
 
-      m_guilds[guild_id].update_presence(presence);
+        if (!id.empty())
+        {
+          m_cache.invalidate("guilds/" + Snowflake(data["guild_id"]).to_string() + "/members/" + id);
+          m_cache.invalidate("users/" + id);
+        }
+        break;
+      }
+    case DispatchEvent::PresenceUpdate:
+      {
+        //  Presences only carry the full user when part of it changed.
+        auto user = data.FindMember("user");
 
-      raise_event(PresenceUpdate, data);
-    }
-    else if (event_name == "TYPING_START")
-    {
-      raise_event(Typing, data);
+        if (user != data.MemberEnd() && user->value.IsObject() && user->value.HasMember("username"))
+        {
+          m_cache.invalidate("users/" + user_id());
+        }
+        break;
+      }
+    default:;
     }
-    else if (event_name == "VOICE_STATE_UPDATE")
-    {
+  }
 
-    }
-    else if (event_name == "VOICE_SERVER_UPDATE")
-    {
+  void ConnectionState::on_dispatch(DispatchEvent event, rapidjson::Value& data)
+  {
+    invalidate_cache(event, data);
+
+    auto handler = DISPATCH_TABLE[static_cast<size_t>(event)];
 
+    if (handler)
+    {
+      (this->*handler)(data);
     }
   }
 
@@ -608,6 +1105,11 @@ namespace discord
     m_event_handler = callback;
   }
 
+  void ConnectionState::on_guild_created(std::function<void(Guild&)> callback)
+  {
+    m_guild_created_handler = callback;
+  }
+
   const std::string& ConnectionState::token() const
   {
     return m_token;
@@ -0,0 +1,143 @@
+#include <cstring>
+
+#include "dispatch_event.h"
+
+namespace discord
+{
+  namespace
+  {
+    constexpr size_t EVENT_COUNT = static_cast<size_t>(DispatchEvent::Count);
+
+    /** Event names, in the same order as DispatchEvent. */
+    constexpr const char* EVENT_NAMES[EVENT_COUNT] =
+    {
+      "UNKNOWN",
+      "READY",
+      "RESUMED",
+      "CHANNEL_CREATE",
+      "CHANNEL_UPDATE",
+      "CHANNEL_DELETE",
+      "CHANNEL_PINS_UPDATE",
+      "GUILD_CREATE",
+      "GUILD_UPDATE",
+      "GUILD_DELETE",
+      "GUILD_BAN_ADD",
+      "GUILD_BAN_REMOVE",
+      "GUILD_EMOJIS_UPDATE",
+      "GUILD_INTEGRATIONS_UPDATE",
+      "GUILD_MEMBER_ADD",
+      "GUILD_MEMBER_REMOVE",
+      "GUILD_MEMBER_UPDATE",
+      "GUILD_MEMBERS_CHUNK",
+      "GUILD_ROLE_CREATE",
+      "GUILD_ROLE_UPDATE",
+      "GUILD_ROLE_DELETE",
+      "MESSAGE_CREATE",
+      "MESSAGE_UPDATE",
+      "MESSAGE_DELETE",
+      "MESSAGE_DELETE_BULK",
+      "MESSAGE_REACTION_ADD",
+      "MESSAGE_REACTION_REMOVE",
+      "MESSAGE_REACTION_REMOVE_ALL",
+      "PRESENCE_UPDATE",
+      "TYPING_START",
+      "USER_UPDATE",
+      "VOICE_STATE_UPDATE",
+      "VOICE_SERVER_UPDATE",
+      "WEBHOOKS_UPDATE"
+    };
+
+    //  The hash is FNV-1a with a seed that was searched for to make it collision free over the
+    //  names above. The top bits of the hash pick the slot because FNV's low bits mix poorly.
+    constexpr uint32_t HASH_SEED = 14220;
+    constexpr uint32_t TABLE_BITS = 6;
+    constexpr size_t TABLE_SIZE = size_t(1) << TABLE_BITS;
+
+    constexpr size_t const_length(const char* str)
+    {
+      size_t length = 0;
+      while (str[length])
+      {
+        ++length;
+      }
+
+      return length;
+    }
+
+    constexpr size_t slot(const char* name, size_t length)
+    {
+      uint32_t hash = 2166136261u ^ HASH_SEED;
+
+      for (size_t i = 0; i < length; ++i)
+      {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 16777619u;
+      }
+
+      return hash >> (32 - TABLE_BITS);
+    }
+
+    struct SlotTable
+    {
+      DispatchEvent slots[TABLE_SIZE];
+      bool perfect;
+    };
+
+    constexpr SlotTable build_table()
+    {
+      SlotTable table = {};
+
+      for (size_t i = 0; i < TABLE_SIZE; ++i)
+      {
+        table.slots[i] = DispatchEvent::Unknown;
+      }
+
+      table.perfect = true;
+
+      //  Unknown has no name on the wire, so it doesn't take a slot.
+      for (size_t event = 1; event < EVENT_COUNT; ++event)
+      {
+        auto index = slot(EVENT_NAMES[event], const_length(EVENT_NAMES[event]));
+
+        if (table.slots[index] != DispatchEvent::Unknown)
+        {
+          table.perfect = false;
+        }
+
+        table.slots[index] = static_cast<DispatchEvent>(event);
+      }
+
+      return table;
+    }
+
+    constexpr SlotTable EVENT_TABLE = build_table();
+
+    static_assert(EVENT_TABLE.perfect, "Dispatch event names collide, HASH_SEED must be searched for again.");
+  }
+
+  DispatchEvent to_dispatch_event(const char* name, size_t length)
+  {
+    auto event = EVENT_TABLE.slots[slot(name, length)];
+    auto expected = EVENT_NAMES[static_cast<size_t>(event)];
+
+    //  The slot only says which event it could be, so confirm it is actually that event.
+    if (event == DispatchEvent::Unknown || strlen(expected) != length || memcmp(expected, name, length) != 0)
+    {
+      return DispatchEvent::Unknown;
+    }
+
+    return event;
+  }
+
+  const char* dispatch_event_name(DispatchEvent event)
+  {
+    auto index = static_cast<size_t>(event);
+
+    if (index >= EVENT_COUNT)
+    {
+      return EVENT_NAMES[0];
+    }
+
+    return EVENT_NAMES[index];
+  }
+}
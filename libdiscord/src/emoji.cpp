@@ -19,7 +19,7 @@ namespace discord
     {
       for (const auto& emoji_role : data["roles"].GetArray())
       {
-        m_roles.emplace_back(emoji_role.GetString());
+        m_roles.emplace_back(emoji_role);
       }
     }
 
@@ -0,0 +1,600 @@
+#include <cstring>
+#include <string>
+
+#include "etf.h"
+
+namespace discord
+{
+  namespace etf
+  {
+    bool Decoder::decode_term(PooledDocument& handler)
+    {
+      if (!require(1))
+      {
+        return false;
+      }
+
+      switch (read8())
+      {
+      case SmallInteger:
+        return require(1) && handler.Uint(read8());
+      case Integer:
+        {
+          if (!require(4))
+          {
+            return false;
+          }
+
+          auto value = static_cast<int32_t>(read32());
+          return value < 0 ? handler.Int(value) : handler.Uint(static_cast<uint32_t>(value));
+        }
+      case NewFloat:
+        {
+          if (!require(8))
+          {
+            return false;
+          }
+
+          uint64_t bits = static_cast<uint64_t>(read32()) << 32;
+          bits |= read32();
+
+          double value;
+          memcpy(&value, &bits, sizeof(value));
+          return handler.Double(value);
+        }
+      case Float:
+        {
+          //  Old float format, a null padded 31 byte string.
+          if (!require(31))
+          {
+            return false;
+          }
+
+          char text[32] = {};
+          memcpy(text, m_data + m_pos, 31);
+          m_pos += 31;
+          return handler.Double(std::strtod(text, nullptr));
+        }
+      case Atom:
+      case AtomUtf8:
+        return require(2) && decode_atom(handler, read16());
+      case SmallAtom:
+      case SmallAtomUtf8:
+        return require(1) && decode_atom(handler, read8());
+      case Binary:
+        {
+          if (!require(4))
+          {
+            return false;
+          }
+
+          auto length = read32();
+
+          if (!require(length))
+          {
+            return false;
+          }
+
+          auto str = reinterpret_cast<const char*>(m_data + m_pos);
+          m_pos += length;
+          return handler.String(str, length, true);
+        }
+      case String:
+        {
+          //  A list of bytes that Erlang packed into a string.
+          if (!require(2))
+          {
+            return false;
+          }
+
+          auto length = read16();
+
+          if (!require(length))
+          {
+            return false;
+          }
+
+          auto str = reinterpret_cast<const char*>(m_data + m_pos);
+          m_pos += length;
+          return handler.String(str, length, true);
+        }
+      case SmallBig:
+        return require(1) && decode_big(handler, read8());
+      case LargeBig:
+        return require(4) && decode_big(handler, read32());
+      case Nil:
+        return handler.StartArray() && handler.EndArray(0);
+      case SmallTuple:
+      case LargeTuple:
+      case List:
+        {
+          auto tag = m_data[m_pos - 1];
+          uint32_t length;
+
+          if (tag == SmallTuple)
+          {
+            if (!require(1))
+            {
+              return false;
+            }
+
+            length = read8();
+          }
+          else
+          {
+            if (!require(4))
+            {
+              return false;
+            }
+
+            length = read32();
+          }
+
+          if (!handler.StartArray())
+          {
+            return false;
+          }
+
+          for (uint32_t i = 0; i < length; ++i)
+          {
+            if (!decode_term(handler))
+            {
+              return false;
+            }
+          }
+
+          if (tag == List)
+          {
+            //  Proper lists end with a nil tail, which is not part of the array.
+            if (!require(1))
+            {
+              return false;
+            }
+
+            if (m_data[m_pos] == Nil)
+            {
+              ++m_pos;
+            }
+            else
+            {
+              return fail("Improper lists are not supported");
+            }
+          }
+
+          return handler.EndArray(length);
+        }
+      case Map:
+        {
+          if (!require(4))
+          {
+            return false;
+          }
+
+          auto length = read32();
+
+          if (!handler.StartObject())
+          {
+            return false;
+          }
+
+          for (uint32_t i = 0; i < length; ++i)
+          {
+            if (!decode_key(handler) || !decode_term(handler))
+            {
+              return false;
+            }
+          }
+
+          return handler.EndObject(length);
+        }
+      default:
+        return fail("Unsupported ETF tag");
+      }
+    }
+
+    bool Decoder::decode_key(PooledDocument& handler)
+    {
+      if (!require(1))
+      {
+        return false;
+      }
+
+      size_t length;
+
+      //  Keys must always end up as strings, even the atoms that would otherwise be nil or a bool.
+      switch (read8())
+      {
+      case Atom:
+      case AtomUtf8:
+      case String:
+        if (!require(2))
+        {
+          return false;
+        }
+
+        length = read16();
+        break;
+      case SmallAtom:
+      case SmallAtomUtf8:
+        if (!require(1))
+        {
+          return false;
+        }
+
+        length = read8();
+        break;
+      case Binary:
+        if (!require(4))
+        {
+          return false;
+        }
+
+        length = read32();
+        break;
+      case SmallInteger:
+        {
+          if (!require(1))
+          {
+            return false;
+          }
+
+          auto key = std::to_string(read8());
+          return handler.Key(key.c_str(), static_cast<rapidjson::SizeType>(key.size()), true);
+        }
+      case Integer:
+        {
+          if (!require(4))
+          {
+            return false;
+          }
+
+          auto key = std::to_string(static_cast<int32_t>(read32()));
+          return handler.Key(key.c_str(), static_cast<rapidjson::SizeType>(key.size()), true);
+        }
+      default:
+        return fail("Unsupported ETF map key");
+      }
+
+      if (!require(length))
+      {
+        return false;
+      }
+
+      auto key = reinterpret_cast<const char*>(m_data + m_pos);
+      m_pos += length;
+      return handler.Key(key, static_cast<rapidjson::SizeType>(length), true);
+    }
+
+    bool Decoder::decode_atom(PooledDocument& handler, size_t length)
+    {
+      if (!require(length))
+      {
+        return false;
+      }
+
+      auto name = reinterpret_cast<const char*>(m_data + m_pos);
+      m_pos += length;
+
+      if (length == 3 && memcmp(name, "nil", 3) == 0)
+      {
+        return handler.Null();
+      }
+
+      if (length == 4 && memcmp(name, "null", 4) == 0)
+      {
+        return handler.Null();
+      }
+
+      if (length == 4 && memcmp(name, "true", 4) == 0)
+      {
+        return handler.Bool(true);
+      }
+
+      if (length == 5 && memcmp(name, "false", 5) == 0)
+      {
+        return handler.Bool(false);
+      }
+
+      return handler.String(name, static_cast<rapidjson::SizeType>(length), true);
+    }
+
+    bool Decoder::decode_big(PooledDocument& handler, size_t length)
+    {
+      if (!require(length + 1))
+      {
+        return false;
+      }
+
+      auto negative = read8() != 0;
+
+      if (length > 8)
+      {
+        return fail("Integer is too large to decode");
+      }
+
+      //  Big integers are stored as little endian bytes.
+      uint64_t value = 0;
+      for (size_t i = 0; i < length; ++i)
+      {
+        value |= static_cast<uint64_t>(m_data[m_pos + i]) << (8 * i);
+      }
+
+      m_pos += length;
+
+      if (negative)
+      {
+        return handler.Int64(-static_cast<int64_t>(value));
+      }
+
+      return handler.Uint64(value);
+    }
+
+    bool Decoder::fail(const char* error)
+    {
+      m_error = error;
+      return false;
+    }
+
+    bool Decoder::require(size_t bytes)
+    {
+      if (m_size - m_pos < bytes)
+      {
+        return fail("Unexpected end of ETF payload");
+      }
+
+      return true;
+    }
+
+    uint8_t Decoder::read8()
+    {
+      return m_data[m_pos++];
+    }
+
+    uint16_t Decoder::read16()
+    {
+      uint16_t value = static_cast<uint16_t>((m_data[m_pos] << 8) | m_data[m_pos + 1]);
+      m_pos += 2;
+      return value;
+    }
+
+    uint32_t Decoder::read32()
+    {
+      uint32_t value = (static_cast<uint32_t>(m_data[m_pos]) << 24) |
+        (static_cast<uint32_t>(m_data[m_pos + 1]) << 16) |
+        (static_cast<uint32_t>(m_data[m_pos + 2]) << 8) |
+        static_cast<uint32_t>(m_data[m_pos + 3]);
+      m_pos += 4;
+      return value;
+    }
+
+    Decoder::Decoder(const char* data, size_t size)
+      : m_data(reinterpret_cast<const uint8_t*>(data)), m_size(size), m_pos(0), m_error(nullptr)
+    {
+    }
+
+    bool Decoder::operator()(PooledDocument& handler)
+    {
+      if (!require(1))
+      {
+        return false;
+      }
+
+      if (read8() != Version)
+      {
+        return fail("Unknown ETF version");
+      }
+
+      return decode_term(handler);
+    }
+
+    const char* Decoder::error() const
+    {
+      return m_error;
+    }
+
+    void Encoder::write8(uint8_t value)
+    {
+      m_buffer.push_back(value);
+    }
+
+    void Encoder::write32(uint32_t value)
+    {
+      m_buffer.push_back(static_cast<uint8_t>(value >> 24));
+      m_buffer.push_back(static_cast<uint8_t>(value >> 16));
+      m_buffer.push_back(static_cast<uint8_t>(value >> 8));
+      m_buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void Encoder::patch32(size_t pos, uint32_t value)
+    {
+      m_buffer[pos] = static_cast<uint8_t>(value >> 24);
+      m_buffer[pos + 1] = static_cast<uint8_t>(value >> 16);
+      m_buffer[pos + 2] = static_cast<uint8_t>(value >> 8);
+      m_buffer[pos + 3] = static_cast<uint8_t>(value);
+    }
+
+    void Encoder::write_atom(const char* name, uint8_t length)
+    {
+      write8(SmallAtomUtf8);
+      write8(length);
+      m_buffer.insert(std::end(m_buffer), name, name + length);
+    }
+
+    void Encoder::write_big(uint64_t value, bool negative)
+    {
+      write8(SmallBig);
+      auto length_pos = m_buffer.size();
+      write8(0);
+      write8(negative ? 1 : 0);
+
+      uint8_t length = 0;
+      while (value)
+      {
+        write8(static_cast<uint8_t>(value & 0xFF));
+        value >>= 8;
+        ++length;
+      }
+
+      m_buffer[length_pos] = length;
+    }
+
+    Encoder::Encoder(std::vector<uint8_t>& buffer) : m_buffer(buffer)
+    {
+      reset();
+    }
+
+    void Encoder::reset()
+    {
+      m_buffer.clear();
+      m_positions.clear();
+      write8(Version);
+    }
+
+    bool Encoder::Null()
+    {
+      write_atom("nil", 3);
+      return true;
+    }
+
+    bool Encoder::Bool(bool b)
+    {
+      if (b)
+      {
+        write_atom("true", 4);
+      }
+      else
+      {
+        write_atom("false", 5);
+      }
+
+      return true;
+    }
+
+    bool Encoder::Int(int i)
+    {
+      if (i >= 0 && i <= 255)
+      {
+        write8(SmallInteger);
+        write8(static_cast<uint8_t>(i));
+      }
+      else
+      {
+        write8(Integer);
+        write32(static_cast<uint32_t>(i));
+      }
+
+      return true;
+    }
+
+    bool Encoder::Uint(unsigned u)
+    {
+      if (u <= static_cast<unsigned>(INT32_MAX))
+      {
+        return Int(static_cast<int>(u));
+      }
+
+      write_big(u, false);
+      return true;
+    }
+
+    bool Encoder::Int64(int64_t i)
+    {
+      if (i >= INT32_MIN && i <= INT32_MAX)
+      {
+        return Int(static_cast<int>(i));
+      }
+
+      if (i < 0)
+      {
+        write_big(static_cast<uint64_t>(-(i + 1)) + 1, true);
+      }
+      else
+      {
+        write_big(static_cast<uint64_t>(i), false);
+      }
+
+      return true;
+    }
+
+    bool Encoder::Uint64(uint64_t u)
+    {
+      if (u <= static_cast<uint64_t>(INT32_MAX))
+      {
+        return Int(static_cast<int>(u));
+      }
+
+      write_big(u, false);
+      return true;
+    }
+
+    bool Encoder::Double(double d)
+    {
+      uint64_t bits;
+      memcpy(&bits, &d, sizeof(bits));
+
+      write8(NewFloat);
+      write32(static_cast<uint32_t>(bits >> 32));
+      write32(static_cast<uint32_t>(bits));
+      return true;
+    }
+
+    bool Encoder::RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+    {
+      return String(str, length, copy);
+    }
+
+    bool Encoder::String(const char* str, rapidjson::SizeType length, bool copy)
+    {
+      write8(Binary);
+      write32(length);
+      m_buffer.insert(std::end(m_buffer), str, str + length);
+      return true;
+    }
+
+    bool Encoder::StartObject()
+    {
+      write8(Map);
+      m_positions.push_back(m_buffer.size());
+      write32(0);
+      return true;
+    }
+
+    bool Encoder::Key(const char* str, rapidjson::SizeType length, bool copy)
+    {
+      return String(str, length, copy);
+    }
+
+    bool Encoder::EndObject(rapidjson::SizeType member_count)
+    {
+      patch32(m_positions.back(), member_count);
+      m_positions.pop_back();
+      return true;
+    }
+
+    bool Encoder::StartArray()
+    {
+      write8(List);
+      m_positions.push_back(m_buffer.size());
+      write32(0);
+      return true;
+    }
+
+    bool Encoder::EndArray(rapidjson::SizeType element_count)
+    {
+      auto pos = m_positions.back();
+      m_positions.pop_back();
+
+      if (element_count == 0)
+      {
+        //  An empty list is written as a lone nil instead.
+        m_buffer.resize(pos - 1);
+        write8(Nil);
+        return true;
+      }
+
+      patch32(pos, element_count);
+      write8(Nil);
+      return true;
+    }
+  }
+}
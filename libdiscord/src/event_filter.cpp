@@ -0,0 +1,79 @@
+#include "event_filter.h"
+
+namespace discord
+{
+  uint64_t EventFilter::bit(DispatchEvent event)
+  {
+    return uint64_t(1) << static_cast<size_t>(event);
+  }
+
+  EventFilter::EventFilter() : m_consumed(0), m_ignored(0)
+  {
+    static_assert(static_cast<size_t>(DispatchEvent::Count) <= 64, "Every dispatch event needs a bit in the filter masks.");
+
+    consume(DispatchEvent::Ready);
+    consume(DispatchEvent::Resumed);
+  }
+
+  void EventFilter::consume(DispatchEvent event)
+  {
+    m_consumed |= bit(event);
+  }
+
+  void EventFilter::ignore(DispatchEvent event, bool ignore)
+  {
+    if (ignore)
+    {
+      m_ignored |= bit(event);
+    }
+    else
+    {
+      m_ignored &= ~bit(event);
+    }
+  }
+
+  void EventFilter::allow_guilds(const std::vector<Snowflake>& guilds)
+  {
+    std::shared_ptr<const std::unordered_set<uint64_t>> allowed;
+
+    if (!guilds.empty())
+    {
+      auto ids = std::make_shared<std::unordered_set<uint64_t>>();
+
+      for (const auto& guild : guilds)
+      {
+        ids->insert(guild.id());
+      }
+
+      allowed = ids;
+    }
+
+    std::atomic_store(&m_guilds, allowed);
+  }
+
+  bool EventFilter::filters_guilds() const
+  {
+    return std::atomic_load(&m_guilds) != nullptr;
+  }
+
+  bool EventFilter::accepts(DispatchEvent event, uint64_t guild_id) const
+  {
+    if (event == DispatchEvent::Ready || event == DispatchEvent::Resumed)
+    {
+      return true;
+    }
+
+    if ((m_consumed & bit(event)) == 0 || (m_ignored & bit(event)) != 0)
+    {
+      return false;
+    }
+
+    if (guild_id == 0)
+    {
+      return true;
+    }
+
+    auto guilds = std::atomic_load(&m_guilds);
+    return !guilds || guilds->count(guild_id) != 0;
+  }
+}
@@ -1,97 +1,321 @@
+#include <algorithm>
+#include <thread>
 #include <cpprest/http_msg.h>
 #include <zlib.h>
 
 #include "api.h"
+#include "discord_exception.h"
 #include "gateway.h"
+#include "payload_header.h"
 
 namespace discord
 {
   const uint8_t Gateway::LARGE_SERVER = 100;
+  const uint8_t Gateway::MIN_LARGE_THRESHOLD = 50;
+  const uint8_t Gateway::MAX_LARGE_THRESHOLD = 250;
   const utility::string_t Gateway::VERSION = utility::string_t(U("6"));
-  const utility::string_t Gateway::ENCODING = utility::string_t(U("json"));
+  const utility::string_t Gateway::JSON_ENCODING = utility::string_t(U("json"));
+  const utility::string_t Gateway::ETF_ENCODING = utility::string_t(U("etf"));
+  const utility::string_t Gateway::TRANSPORT_COMPRESSION = utility::string_t(U("zlib-stream"));
+  const std::chrono::milliseconds Gateway::RECONNECT_BASE_DELAY = std::chrono::milliseconds(1000);
+  const std::chrono::milliseconds Gateway::RECONNECT_MAX_DELAY = std::chrono::milliseconds(60000);
+  const uint32_t Gateway::SEND_LIMIT = 120;
+  const std::chrono::milliseconds Gateway::SEND_PERIOD = std::chrono::milliseconds(60000);
+  const uint32_t Gateway::PRIORITY_RESERVE = 5;
+  const uint32_t Gateway::DEFAULT_MAX_MISSED_ACKS = 1;
+  const size_t Gateway::RECEIVE_SLOTS = 32;
+  const size_t Gateway::SLOT_POOL_SIZE = 4 * 1024;
+  const size_t Gateway::SLOT_POOL_LIMIT = 1024 * 1024;
+
+  namespace
+  {
+    /** Writes a string key to a SAX handler. */
+    template <typename Handler, size_t N>
+    void write_key(Handler& handler, const char (&key)[N])
+    {
+      handler.Key(key, N - 1, false);
+    }
+  }
+
+  template <typename Handler>
+  void Gateway::write_priority_data(Handler& handler, Opcode op)
+  {
+    if (op == Heartbeat)
+    {
+      handler.Uint(m_last_seq);
+    }
+    else if (op == Identify)
+    {
+      handler.StartObject();
+      write_key(handler, "token");
+      handler.String(m_token.c_str(), m_token.size(), false);
+      write_key(handler, "properties");
+      m_identify_properties.Accept(handler);
+      write_key(handler, "compress");
+      handler.Bool(m_compression == Compression::Payload);
+      write_key(handler, "large_threshold");
+      handler.Uint(m_large_threshold);
+      write_key(handler, "shard");
+      handler.StartArray();
+      handler.Int(m_shard);
+      handler.Int(m_total_shards);
+      handler.EndArray(2);
+      handler.EndObject(5);
+    }
+    else if (op == Resume)
+    {
+      handler.StartObject();
+      write_key(handler, "token");
+      handler.String(m_token.c_str(), m_token.size(), false);
+      write_key(handler, "session_id");
+      handler.String(m_session_id.c_str(), m_session_id.size(), false);
+      write_key(handler, "seq");
+      handler.Uint(m_last_seq);
+      handler.EndObject(3);
+    }
+  }
 
   void Gateway::connect()
   {
+    //  Frames from the new connection are tagged with the new generation, which tells the parser
+    //  to start a new zlib stream when it gets to them.
+    ++m_generation;
+
     try
     {
-      m_client.connect(m_wss_url);
+      m_client.connect(m_wss_url).then([this](pplx::task<void> task)
+      {
+        try
+        {
+          task.get();
+        }
+        catch (const std::exception& e)
+        {
+          LOG(ERROR) << "Could not connect to " << utility::conversions::to_utf8string(m_wss_url) << ": " << e.what();
+          schedule_reconnect();
+        }
+      });
     }
     catch (const std::exception& e)
     {
-      LOG(ERROR) << "Could not connect to " << m_wss_url << ": " << e.what();
+      LOG(ERROR) << "Could not connect to " << utility::conversions::to_utf8string(m_wss_url) << ": " << e.what();
+      schedule_reconnect();
     }
   }
 
-  void Gateway::on_message(web::websockets::client::websocket_incoming_message msg)
+  void Gateway::schedule_reconnect()
   {
-    std::string str;
+    if (m_stopping)
+    {
+      return;
+    }
+
+    //  Back off exponentially so a gateway outage doesn't turn into a reconnect storm.
+    auto shift = std::min(m_reconnect_attempts, static_cast<uint32_t>(16));
+    auto delay = std::min(RECONNECT_BASE_DELAY * (1 << shift), RECONNECT_MAX_DELAY);
+    ++m_reconnect_attempts;
 
-    //  If the message is binary data, then we need to decompress it using ZLib.
-    if (msg.message_type() == web::websockets::client::websocket_message_type::binary_message)
+    LOG(INFO) << "Reconnecting shard " << m_shard << " in " << delay.count() << "ms.";
+
+    m_timers.cancel(m_reconnect_timer);
+    m_reconnect_timer = m_timers.schedule(delay, [this]()
     {
-      Concurrency::streams::container_buffer<std::string> strbuf;
+      connect();
+    });
+  }
 
-      //  Read the entire binary payload and put into a string container
-      auto task = msg.body().read_to_end(strbuf).then([strbuf](size_t bytesRead)
-      {
-        return strbuf.collection();
-      });
+  void Gateway::on_message(web::websockets::client::websocket_incoming_message msg)
+  {
+    if (m_stopping)
+    {
+      return;
+    }
+
+    std::unique_ptr<ReceiveSlot> overflow;
 
-      z_stream zs;
-      memset(&zs, 0, sizeof(zs));
+    {
+      //  Once anything is in the backlog, everything after it has to go there too to keep the order.
+      std::lock_guard<std::mutex> lock(m_backlog_mutex);
 
-      if (inflateInit(&zs) != Z_OK)
+      if (!m_backlog.empty() || m_received - m_dispatched >= RECEIVE_SLOTS)
       {
-        LOG(ERROR) << "Could not initialize zlib Inflate";
-        return;
+        if (m_backlog.empty())
+        {
+          LOG(WARNING) << "Receive pipeline of shard " << m_shard << " is full, queueing frames until dispatch catches up.";
+        }
+
+        overflow = std::make_unique<ReceiveSlot>();
       }
+    }
+
+    auto& slot = overflow ? *overflow : m_slots[m_received % RECEIVE_SLOTS];
+
+    //  Read the frame straight out of the websocket buffer into the slot's reusable frame buffer.
+    auto length = msg.length();
+    slot.frame.resize(length + 1);
+    msg.body().streambuf().getn(reinterpret_cast<uint8_t *>(slot.frame.data()), length).get();
+    slot.frame[length] = '\0';
+    slot.size = length;
+    slot.binary = msg.message_type() == web::websockets::client::websocket_message_type::binary_message;
+    slot.generation = m_generation;
+    slot.event = DispatchEvent::Unknown;
+    slot.data = nullptr;
 
-      std::string compressed = task.get();
+    if (overflow)
+    {
+      std::lock_guard<std::mutex> lock(m_backlog_mutex);
+      m_backlog.push_back(std::move(overflow));
+    }
+    else
+    {
+      ++m_received;
+    }
 
-      zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
-      zs.avail_in = static_cast<uInt>(compressed.size());
+    //  Start a parser only if there isn't one already, otherwise the running parser will get to it.
+    if (m_parse_pending.fetch_add(1) == 0)
+    {
+      pplx::create_task([this]() { parse_frames(); });
+    }
+  }
 
-      int ret;
-      char buffer[32768];
+  void Gateway::parse_frames()
+  {
+    do
+    {
+      //  Frames in the ring always arrived before the ones in the backlog.
+      ReceiveSlot* slot;
+      auto from_ring = m_parsed < m_received;
 
-      do
+      if (from_ring)
       {
-        zs.next_out = reinterpret_cast<Bytef *>(buffer);
-        zs.avail_out = sizeof(buffer);
-
-        ret = inflate(&zs, 0);
+        slot = &m_slots[m_parsed % RECEIVE_SLOTS];
+      }
+      else
+      {
+        std::lock_guard<std::mutex> lock(m_backlog_mutex);
+        slot = m_backlog[m_backlog_parsed].get();
+      }
 
-        if (str.size() < zs.total_out)
+      try
+      {
+        if (!m_stopping)
         {
-          str.append(buffer, zs.total_out - str.size());
+          parse_frame(*slot);
         }
-      } while (ret == Z_OK);
+      }
+      catch (const std::exception& e)
+      {
+        LOG(ERROR) << "WebSocket Exception: " << e.what();
+        slot->event = DispatchEvent::Unknown;
+      }
 
-      inflateEnd(&zs);
+      if (from_ring)
+      {
+        ++m_parsed;
+      }
+      else
+      {
+        std::lock_guard<std::mutex> lock(m_backlog_mutex);
+        ++m_backlog_parsed;
+      }
+
+      //  Every frame goes through dispatch, even ones without an event, so slots are freed in order.
+      if (m_dispatch_pending.fetch_add(1) == 0)
+      {
+        pplx::create_task([this]() { dispatch_events(); });
+      }
+    } while (m_parse_pending.fetch_sub(1) != 1);
+  }
+
+  void Gateway::parse_frame(ReceiveSlot& slot)
+  {
+    char* payload_data = slot.frame.data();
+    size_t payload_size = slot.size;
 
-      if (ret != Z_STREAM_END)
+    //  Every new connection starts a new zlib stream.
+    if (slot.generation != m_inflater_generation)
+    {
+      m_inflater.reset();
+      m_inflater_generation = slot.generation;
+    }
+
+    //  If the message is binary data and compression is on, then we need to decompress it using ZLib.
+    if (slot.binary && m_compression != Compression::None)
+    {
+      try
+      {
+        if (m_compression == Compression::Stream)
+        {
+          //  Wait for the rest of the payload if this frame didn't complete it.
+          if (!m_inflater.push(payload_data, payload_size))
+          {
+            return;
+          }
+        }
+        else
+        {
+          m_inflater.inflate_payload(payload_data, payload_size);
+        }
+      }
+      catch (const DiscordException& e)
       {
-        LOG(ERROR) << "Error during zlib decompression: (" << ret << ")";
+        //  The shared zlib context is unusable after an error, so start over with a new connection.
+        LOG(ERROR) << e.what() << ". Closing connection.";
+        m_client.close();
         return;
       }
+
+      //  The inflater reuses its buffer for the next payload, so the text moves into the slot
+      //  where it can live until the event is dispatched.
+      slot.frame.assign(m_inflater.data(), m_inflater.data() + m_inflater.size() + 1);
+      payload_data = slot.frame.data();
+      payload_size = m_inflater.size();
     }
-    else
+
+    PayloadHeader header;
+    auto event = DispatchEvent::Unknown;
+    auto stream_guilds = m_guild_reader && m_encoding == Encoding::JSON;
+
+    //  Only look at the header if something is going to use it.
+    if (m_filter || stream_guilds)
     {
-      //  If not compressed, just get the string.
-      str = msg.extract_string().get();
+      event = scan_payload(payload_data, payload_size, header);
     }
 
-    //  Parse our payload as JSON.
-    rapidjson::Document payload;
-    payload.Parse(str.c_str(), str.size());
+    if (m_filter && event != DispatchEvent::Unknown && filter_payload(event, header))
+    {
+      return;
+    }
 
-    if (str.size() > 1000)
+#if ELPP_DEBUG_LOG
+    //  Parsing in place destroys the payload text, so log it beforehand.
+    if (m_encoding == Encoding::JSON)
     {
-      LOG(DEBUG) << "Got WS Payload: " << str.substr(0, 1000);
+      LOG(DEBUG) << "Got WS Payload: " << std::string(payload_data, std::min(payload_size, static_cast<size_t>(1000)));
     }
-    else
+#endif
+
+    if (stream_guilds && event == DispatchEvent::GuildCreate)
     {
-      LOG(DEBUG) << "Got WS Payload: " << str;
+      read_guild(slot, payload_data, header);
+      return;
+    }
+
+    etf::Decoder decoder(payload_data, payload_size);
+
+    //  Parse our payload, in place and out of pooled memory.
+    auto& payload = m_encoding == Encoding::ETF ? slot.pool.populate(decoder) : slot.pool.parse_insitu(payload_data);
+
+    if (m_encoding == Encoding::ETF && decoder.error())
+    {
+      LOG(ERROR) << "Could not decode WS Payload: " << decoder.error();
+      return;
+    }
+
+    if (payload.HasParseError())
+    {
+      LOG(ERROR) << "Could not parse WS Payload (error " << payload.GetParseError() << " at " << payload.GetErrorOffset() << ")";
+      return;
     }
 
     rapidjson::Value& data = payload["d"]; //  Get the data for the event
@@ -99,37 +323,54 @@ namespace discord
     switch (payload["op"].GetInt())
     {
     case Dispatch:
-      m_last_seq = payload["s"].GetInt();
-      handle_dispatch_event(payload["t"].GetString(), data);
-      break;
+      {
+        set_last_seq(payload["s"].GetInt());
+
+        //  Map the event name to its enumeration once, here, so nothing after has to compare strings.
+        auto& event_name = payload["t"];
+        auto event = to_dispatch_event(event_name.GetString(), event_name.GetStringLength());
+
+        if (event == DispatchEvent::Unknown)
+        {
+          LOG(DEBUG) << "Unknown dispatch event " << event_name.GetString();
+          break;
+        }
+
+        //  Connection state is handled now, the rest waits for the dispatch stage.
+        if (handle_dispatch_event(event, data))
+        {
+          slot.event = event;
+          slot.data = &data;
+        }
+        break;
+      }
     case Reconnect:
       send_resume();
       break;
     case Invalidate_Session:
       LOG(INFO) << "Session was invalidated, sending identify packet again.";
-      send_identify();
+
+      if (m_session_store)
+      {
+        m_session_store->clear();
+      }
+
+      schedule_identify();
       break;
     case Hello:
       m_connected = true;
+      m_reconnect_attempts = 0;
       m_heartbeat_interval = data["heartbeat_interval"].GetInt();
       LOG(DEBUG) << "Set heartbeat interval to " << m_heartbeat_interval;
 
-      m_heartbeat_thread = std::thread([&]() {
-        while (connected())
-        {
-          LOG(DEBUG) << "Sending heartbeat.";
-          try
-          {
-            send_heartbeat();
-            std::this_thread::sleep_for(std::chrono::milliseconds(m_heartbeat_interval));
-          }
-          catch (const std::exception& e)
-          {
-            LOG(ERROR) << "Could not send a heartbeat: " << e.what();
-          }
-        }
-
-        LOG(DEBUG) << "Disconnected, stopping heartbeats.";
+      //  Heartbeat right away, then let the shared timer wheel keep it going.
+      m_recieved_ack = true;
+      m_missed_acks = 0;
+      m_timers.cancel(m_heartbeat_timer);
+      send_heartbeat();
+      m_heartbeat_timer = m_timers.schedule_every(std::chrono::milliseconds(m_heartbeat_interval), [this]()
+      {
+        send_heartbeat();
       });
 
       if (m_use_resume)
@@ -140,54 +381,293 @@ namespace discord
       else
       {
         LOG(DEBUG) << "Connected, sending Identify packet.";
-        send_identify();
+        schedule_identify();
         m_use_resume = true;  //  Next time use Resume
       }
       break;
     case Heartbeat_ACK:
       LOG(TRACE) << "Recieved Heartbeat ACK.";
       m_recieved_ack = true;
+      m_missed_acks = 0;
+      m_latency.record(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_heartbeat_sent.load()))));
       break;
     default:
       LOG(WARNING) << "Unhandled WS Opcode (" << static_cast<int>(payload["op"].GetInt()) << ")";
     }
   }
 
-  void Gateway::handle_dispatch_event(std::string event_name, rapidjson::Value& data)
+  DispatchEvent Gateway::scan_payload(const char* data, size_t size, PayloadHeader& header)
   {
-    if (event_name == "RESUMED")
+    //  The guild is only worth looking for if the filter drops events by guild.
+    auto need_guild = m_filter && m_filter->filters_guilds();
+    auto scanned = m_encoding == Encoding::ETF ? scan_etf_header(data, size, header, need_guild) : scan_json_header(data, size, header, need_guild);
+
+    //  Anything that isn't clearly a dispatch gets the full parse.
+    if (!scanned || header.op != Dispatch || !header.event || header.seq < 0)
     {
-      LOG(DEBUG) << "Successfully resumed.";
+      return DispatchEvent::Unknown;
+    }
+
+    return to_dispatch_event(header.event, header.event_length);
+  }
+
+  bool Gateway::filter_payload(DispatchEvent event, const PayloadHeader& header)
+  {
+    //  Guild events carry the guild's own id instead of a guild_id.
+    auto guild_event = event == DispatchEvent::GuildCreate || event == DispatchEvent::GuildUpdate || event == DispatchEvent::GuildDelete;
+
+    if (m_filter->accepts(event, guild_event ? header.id : header.guild_id))
+    {
+      return false;
+    }
+
+    //  The sequence still moves forward even though the event is dropped.
+    set_last_seq(static_cast<uint32_t>(header.seq));
+    return true;
+  }
+
+  void Gateway::read_guild(ReceiveSlot& slot, char* data, const PayloadHeader& header)
+  {
+    set_last_seq(static_cast<uint32_t>(header.seq));
+
+    slot.guild = m_guild_reader->read(data);
+
+    if (!slot.guild)
+    {
+      LOG(ERROR) << "Could not parse GUILD_CREATE (error " << m_guild_reader->error() << " at " << m_guild_reader->error_offset() << ")";
       return;
     }
 
-    if (event_name == "READY")
+    slot.event = DispatchEvent::GuildCreate;
+  }
+
+  void Gateway::set_last_seq(uint32_t seq)
+  {
+    m_last_seq = seq;
+
+    if (m_session_store)
+    {
+      m_session_store->save_seq(m_last_seq);
+    }
+  }
+
+  void Gateway::dispatch_events()
+  {
+    do
+    {
+      //  Same as parsing, the ring comes before the backlog.
+      ReceiveSlot* slot;
+      auto from_ring = m_dispatched < m_parsed;
+
+      if (from_ring)
+      {
+        slot = &m_slots[m_dispatched % RECEIVE_SLOTS];
+      }
+      else
+      {
+        std::lock_guard<std::mutex> lock(m_backlog_mutex);
+        slot = m_backlog.front().get();
+      }
+
+      if (slot->event != DispatchEvent::Unknown && !m_stopping)
+      {
+        try
+        {
+          //  Guilds that were built while parsing have no document to pass on.
+          if (slot->guild)
+          {
+            m_on_guild_create(*slot->guild);
+          }
+          else
+          {
+            m_on_dispatch(slot->event, *slot->data);
+          }
+        }
+        catch (const std::exception& e)
+        {
+          LOG(ERROR) << "Exception while dispatching " << dispatch_event_name(slot->event) << ": " << e.what();
+        }
+      }
+
+      if (from_ring)
+      {
+        //  Don't let one huge payload pin a large pool to this slot forever.
+        slot->data = nullptr;
+        slot->guild.reset();
+        slot->pool.trim(SLOT_POOL_LIMIT);
+        ++m_dispatched;
+      }
+      else
+      {
+        std::lock_guard<std::mutex> lock(m_backlog_mutex);
+        m_backlog.pop_front();
+        --m_backlog_parsed;
+      }
+    } while (m_dispatch_pending.fetch_sub(1) != 1);
+  }
+
+  bool Gateway::handle_dispatch_event(DispatchEvent event, rapidjson::Value& data)
+  {
+    if (event == DispatchEvent::Resumed)
+    {
+      LOG(DEBUG) << "Successfully resumed.";
+      return false;
+    }
+
+    if (event == DispatchEvent::Ready)
     {
       LOG(DEBUG) << "Using Gateway version " << data["v"].GetInt();
 
       //  Save session id so we can restart a session
       m_session_id = data["session_id"].GetString();
+
+      if (m_session_store)
+      {
+        m_session_store->save_session(m_session_id, m_last_seq);
+      }
     }
 
-    m_on_dispatch(event_name, data);
+    return true;
   }
 
-  void Gateway::send(Opcode op, rapidjson::Value& packet)
+  void Gateway::drain_send_queue()
   {
-    rapidjson::Document payload(rapidjson::kObjectType);
+    //  Once stopping, everything left is dropped instead of sent, but still counted off
+    //  m_send_pending so the destructor can tell when the sender is done.
+    while (true)
+    {
+      auto pending = m_priority_pending.load();
+      auto priority = pending != 0;
+
+      //  Everything else leaves a few tokens behind so a burst can never delay a heartbeat.
+      auto wait = m_stopping ? std::chrono::milliseconds(0) : m_send_bucket.try_acquire(priority ? 0 : PRIORITY_RESERVE);
+
+      if (wait.count() > 0)
+      {
+        LOG(DEBUG) << "Gateway send limit reached on shard " << m_shard << ", waiting " << wait.count() << "ms.";
+
+        //  Stay the active sender and pick up where we left off once a token is available.
+        std::lock_guard<std::mutex> lock(m_send_timer_mutex);
+        m_send_timer = m_timers.schedule(wait, [this]()
+        {
+          {
+            std::lock_guard<std::mutex> lock(m_send_timer_mutex);
+
+            //  The destructor took over the sender.
+            if (m_send_timer == TimerWheel::INVALID_TIMER)
+            {
+              return;
+            }
+
+            m_send_timer = TimerWheel::INVALID_TIMER;
+          }
+
+          //  The destructor is waiting on the sender, so finish here rather than in a task.
+          if (m_stopping)
+          {
+            drain_send_queue();
+            return;
+          }
+
+          pplx::create_task([this]() { drain_send_queue(); });
+        });
+        return;
+      }
+
+      if (priority)
+      {
+        //  A heartbeat never waits behind an identify or resume.
+        auto op = (pending & (1u << Heartbeat)) ? Heartbeat : (pending & (1u << Identify)) ? Identify : Resume;
+        m_priority_pending.fetch_and(~(1u << op));
+
+        if (op == Heartbeat)
+        {
+          //  Time the round trip from when the heartbeat is actually written, not when it was queued.
+          m_heartbeat_sent = std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+
+        if (!m_stopping)
+        {
+          write_payload(op, nullptr);
+        }
+      }
+      else
+      {
+        auto payload = m_send_queue.front();
 
-    payload.AddMember("op", op, payload.GetAllocator());
-    payload.AddMember("d", packet, payload.GetAllocator());
+        //  Counted but not linked yet. A producer swapped the head and was preempted before linking
+        //  the previous node, so the payloads pushed after it are out of reach until it finishes.
+        while (!payload)
+        {
+          std::this_thread::yield();
+          payload = m_send_queue.front();
+        }
 
-    auto payload_str = json_to_string(payload);
+        if (!m_stopping)
+        {
+          write_payload(payload->op, &payload->data);
+        }
+
+        m_send_queue.pop();
+      }
+
+      if (m_send_pending.fetch_sub(1) == 1)
+      {
+        return;
+      }
+    }
+  }
 
+  void Gateway::write_payload(Opcode op, const rapidjson::Value* data)
+  {
     web::websockets::client::websocket_outgoing_message msg;
-    msg.set_utf8_message(payload_str);
 
-    LOG(DEBUG) << "Sending packet: " << payload_str;
+    //  Writes the {"op": op, "d": data} envelope of the payload.
+    auto write_envelope = [this, op, data](auto& handler)
+    {
+      handler.StartObject();
+      write_key(handler, "op");
+      handler.Int(op);
+      write_key(handler, "d");
+
+      if (data)
+      {
+        data->Accept(handler);
+      }
+      else
+      {
+        this->write_priority_data(handler, op);
+      }
+
+      handler.EndObject(2);
+    };
+
+    if (m_encoding == Encoding::ETF)
+    {
+      m_etf_writer.reset();
+      write_envelope(m_etf_writer);
+
+      LOG(DEBUG) << "Sending ETF packet of " << m_etf_out.size() << " bytes.";
+
+      //  The message has to own its data, so this copy is the only allocation on the way out.
+      auto size = m_etf_out.size();
+      msg.set_binary_message(Concurrency::streams::bytestream::open_istream(std::vector<uint8_t>(m_etf_out)), size);
+    }
+    else
+    {
+      m_json_out.Clear();
+      m_json_writer.Reset(m_json_out);
+      write_envelope(m_json_writer);
+
+      msg.set_utf8_message(std::string(m_json_out.GetString(), m_json_out.GetSize()));
+
+      LOG(DEBUG) << "Sending packet: " << m_json_out.GetString();
+    }
 
     try
     {
+      std::lock_guard<std::mutex> lock(m_client_mutex);
       m_client.send(msg);
     }
     catch (web::websockets::client::websocket_exception& e)
@@ -196,72 +676,184 @@ namespace discord
     }
   }
 
+  void Gateway::send(Opcode op, rapidjson::Document&& packet)
+  {
+    OutboundPayload payload;
+    payload.op = op;
+    payload.data = std::move(packet);
+    m_send_queue.push(std::move(payload));
+
+    //  Start a sender only if there isn't one already, otherwise the running sender will get to it.
+    if (m_send_pending.fetch_add(1) == 0)
+    {
+      pplx::create_task([this]() { drain_send_queue(); });
+    }
+  }
+
+  void Gateway::send_priority(Opcode op)
+  {
+    //  Already waiting, the sender will write it with the latest state.
+    if (m_priority_pending.fetch_or(1u << op) & (1u << op))
+    {
+      return;
+    }
+
+    if (m_send_pending.fetch_add(1) == 0)
+    {
+      pplx::create_task([this]() { drain_send_queue(); });
+    }
+  }
+
   void Gateway::send_heartbeat()
   {
+    if (!m_recieved_ack && ++m_missed_acks >= m_max_missed_acks)
+    {
+      //  The connection is a zombie. The socket may never report that it closed, so don't wait
+      //  for the close handler and schedule the resume here.
+      LOG(WARNING) << "Shard " << m_shard << " missed " << m_missed_acks << " heartbeat ACKs, forcing a reconnect.";
+      m_timers.cancel(m_heartbeat_timer);
+      m_connected = false;
+      m_client.close();
+      schedule_reconnect();
+      return;
+    }
+
     if (!m_recieved_ack)
     {
-      LOG(WARNING) << "Did not recieve a heartbeat ACK packet before this heartbeat.";
+      LOG(WARNING) << "Did not recieve a heartbeat ACK packet before this heartbeat (" << m_missed_acks << " of " << m_max_missed_acks << ").";
     }
 
     LOG(DEBUG) << "Sending heartbeat packet.";
 
-    rapidjson::Document doc(rapidjson::kNumberType);
-    doc.SetInt(m_last_seq);
-    send(Heartbeat, doc);
+    if (m_session_store)
+    {
+      m_session_store->touch();
+    }
+
+    //  Clear the ACK before queueing, it can arrive as soon as the sender writes the heartbeat.
     m_recieved_ack = false;
+
+    send_priority(Heartbeat);
+  }
+
+  void Gateway::schedule_identify()
+  {
+    m_timers.cancel(m_identify_timer);
+    m_identify_timer = m_identify.schedule(m_shard, [this]()
+    {
+      send_identify();
+    });
   }
 
   void Gateway::send_identify()
   {
     LOG(DEBUG) << "Sending identify packet.";
-
-    auto json = R"(
-    {
-      "token": ")" + m_token + R"(",
-      "properties":
-      {
-        "$os": "windows",
-        "$browser": "Discord",
-        "$device": "Discord",
-        "$referrer": "",
-        "$refferring_domain": ""
-      },
-      "compress": true,
-      "large_threshold": )" + std::to_string(LARGE_SERVER) + R"(,
-      "shard": [)" + std::to_string(m_shard) + ", " + std::to_string(m_total_shards) + R"(]
-    })";
-
-    rapidjson::Document doc;
-    doc.Parse(json);
-    send(Identify, doc);
+    send_priority(Identify);
   }
 
   void Gateway::send_resume()
   {
     LOG(DEBUG) << "Sending resume packet.";
+    send_priority(Resume);
+  }
 
-    rapidjson::Document payload(rapidjson::kObjectType);
-    rapidjson::Value token_value;
-    token_value.SetString(m_token.c_str(), m_token.size());
-    rapidjson::Value session_value;
-    session_value.SetString(m_session_id.c_str(), m_session_id.size());
-    rapidjson::Value seq_value(m_last_seq);
-
-    payload.AddMember("token", token_value, payload.GetAllocator());
-    payload.AddMember("sesson_id", session_value, payload.GetAllocator());
-    payload.AddMember("seq", seq_value, payload.GetAllocator());
-
-    send(Resume, payload);
+  Gateway::ReceiveSlot::ReceiveSlot()
+    : size(0), binary(false), generation(0), pool(SLOT_POOL_SIZE), data(nullptr), event(DispatchEvent::Unknown)
+  {
   }
 
-  Gateway::Gateway(utility::string_t wss_url, const std::string& token, int shard, int total_shards)
-    : m_token(token), m_wss_url(wss_url), m_shard(shard), m_total_shards(total_shards)
+  Gateway::Gateway(TimerWheel& timers, IdentifyScheduler& identify, utility::string_t wss_url, const std::string& token, int shard, int total_shards,
+    Encoding encoding, Compression compression)
+    : m_token(token), m_wss_url(wss_url), m_encoding(encoding), m_compression(compression), m_timers(timers), m_identify(identify), m_shard(shard), m_total_shards(total_shards),
+      m_slots(new ReceiveSlot[RECEIVE_SLOTS]), m_received(0), m_parsed(0), m_dispatched(0), m_parse_pending(0), m_dispatch_pending(0), m_backlog_parsed(0),
+      m_generation(0), m_inflater_generation(0), m_priority_pending(0), m_send_pending(0), m_send_bucket(SEND_LIMIT / 2, SEND_PERIOD),
+      m_json_writer(m_json_out), m_etf_writer(m_etf_out), m_identify_properties(rapidjson::kObjectType)
   {
+    if (m_compression == Compression::Stream)
+    {
+      m_wss_url += U("&compress=") + TRANSPORT_COMPRESSION;
+    }
+
     m_heartbeat_interval = 0;
     m_recieved_ack = true; // Set true to start because first hearbeat sent doesn't require an ACK.
     m_last_seq = 0;
     m_connected = false;
+    m_stopping = false;
     m_use_resume = false;
+    m_heartbeat_timer = TimerWheel::INVALID_TIMER;
+    m_reconnect_timer = TimerWheel::INVALID_TIMER;
+    m_identify_timer = TimerWheel::INVALID_TIMER;
+    m_reconnect_attempts = 0;
+    m_send_timer = TimerWheel::INVALID_TIMER;
+    m_heartbeat_sent = 0;
+    m_missed_acks = 0;
+    m_max_missed_acks = DEFAULT_MAX_MISSED_ACKS;
+    m_large_threshold = LARGE_SERVER;
+
+    auto& allocator = m_identify_properties.GetAllocator();
+    m_identify_properties.AddMember("$os", "windows", allocator);
+    m_identify_properties.AddMember("$browser", "Discord", allocator);
+    m_identify_properties.AddMember("$device", "Discord", allocator);
+    m_identify_properties.AddMember("$referrer", "", allocator);
+    m_identify_properties.AddMember("$refferring_domain", "", allocator);
+  }
+
+  Gateway::~Gateway()
+  {
+    m_stopping = true;
+    m_timers.cancel(m_heartbeat_timer);
+    m_timers.cancel(m_reconnect_timer);
+    m_timers.cancel(m_identify_timer);
+
+    try
+    {
+      m_client.close().wait();
+    }
+    catch (const std::exception& e)
+    {
+      LOG(DEBUG) << "Could not close the connection of shard " << m_shard << ": " << e.what();
+    }
+
+    //  A sender waiting for a token is finished here, the timer may never fire once the wheel stops.
+    TimerWheel::TimerId parked;
+
+    {
+      std::lock_guard<std::mutex> lock(m_send_timer_mutex);
+      parked = m_send_timer;
+      m_send_timer = TimerWheel::INVALID_TIMER;
+    }
+
+    if (parked != TimerWheel::INVALID_TIMER)
+    {
+      m_timers.cancel(parked);
+      drain_send_queue();
+    }
+
+    //  The parser, dispatcher and sender run as tasks that point at this gateway. Once stopping
+    //  they skip their work, so this only waits for them to count down what was already queued.
+    while (m_parse_pending != 0 || m_dispatch_pending != 0 || m_send_pending != 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  void Gateway::persist_session(const std::string& path)
+  {
+    try
+    {
+      m_session_store = std::make_unique<SessionStore>(path, m_shard, m_total_shards);
+    }
+    catch (const DiscordException& e)
+    {
+      LOG(ERROR) << e.what() << ". Shard " << m_shard << " will not persist its session.";
+      return;
+    }
+
+    if (m_session_store->load(m_session_id, m_last_seq))
+    {
+      LOG(INFO) << "Found a stored session for shard " << m_shard << ", resuming from sequence " << m_last_seq << ".";
+      m_use_resume = true;
+    }
   }
 
   void Gateway::start()
@@ -280,26 +872,83 @@ namespace discord
 
     m_client.set_close_handler([&](web::websockets::client::websocket_close_status status, const utility::string_t& reason, const std::error_code& code)
     {
+      m_timers.cancel(m_heartbeat_timer);
+      m_timers.cancel(m_identify_timer);
+
       if (m_connected)
       {
         LOG(ERROR) << "WebSocket connection has closed with reason "
           << utility::conversions::to_utf8string(reason) << " - "
           << code.message() << " (" << code.value() << ")";
         m_connected = false;
-        connect();
+        schedule_reconnect();
       }
     });
 
     connect();
   }
 
-  void Gateway::on_dispatch(std::function<void(std::string, rapidjson::Value&)> callback)
+  void Gateway::on_dispatch(std::function<void(DispatchEvent, rapidjson::Value&)> callback)
   {
     m_on_dispatch = callback;
   }
 
+  void Gateway::on_guild_create(ConnectionState* owner, std::function<void(Guild&)> callback)
+  {
+    m_guild_reader = std::make_unique<GuildReader>(owner);
+    m_on_guild_create = callback;
+  }
+
+  void Gateway::set_filter(const EventFilter* filter)
+  {
+    m_filter = filter;
+  }
+
   bool Gateway::connected() const
   {
     return m_connected;
   }
+
+  LatencyStats Gateway::latency() const
+  {
+    return m_latency.stats();
+  }
+
+  void Gateway::set_max_missed_acks(uint32_t max_missed_acks)
+  {
+    m_max_missed_acks = std::max(max_missed_acks, static_cast<uint32_t>(1));
+  }
+
+  void Gateway::set_large_threshold(uint8_t threshold)
+  {
+    m_large_threshold = std::min(std::max(threshold, MIN_LARGE_THRESHOLD), MAX_LARGE_THRESHOLD);
+  }
+
+  void Gateway::request_members(const std::vector<Snowflake>& guild_ids, const std::string& nonce)
+  {
+    rapidjson::Document payload(rapidjson::kObjectType);
+    auto& allocator = payload.GetAllocator();
+
+    rapidjson::Value guilds_value(rapidjson::kArrayType);
+
+    for (const auto& id : guild_ids)
+    {
+      rapidjson::Value id_value;
+      id_value.SetString(id.to_string().c_str(), allocator);
+      guilds_value.PushBack(id_value, allocator);
+    }
+
+    rapidjson::Value query_value("");
+    rapidjson::Value limit_value(0);
+    rapidjson::Value nonce_value;
+    nonce_value.SetString(nonce.c_str(), nonce.size(), allocator);
+
+    //  An empty query with no limit asks for every member.
+    payload.AddMember("guild_id", guilds_value, allocator);
+    payload.AddMember("query", query_value, allocator);
+    payload.AddMember("limit", limit_value, allocator);
+    payload.AddMember("nonce", nonce_value, allocator);
+
+    send(Request_Members, std::move(payload));
+  }
 }
@@ -47,7 +47,7 @@ namespace discord
     {
       for (const auto& role_id : found->value.GetArray())
       {
-        m_roles.emplace_back(role_id.GetString());
+        m_roles.emplace_back(role_id);
       }
     }
 
@@ -165,13 +165,13 @@ namespace discord
       }
     }
 
-    found = data.FindMember("Presences");
+    found = data.FindMember("presences");
     if (found != data.MemberEnd())
     {
-      for (auto& guild_Presence : found->value.GetArray())
+      for (auto& guild_presence : found->value.GetArray())
       {
-        Presence Presence(owner, guild_Presence);
-        m_presences[Presence.user().id()] = Presence;
+        Presence presence(owner, guild_presence);
+        m_presences[presence.user().id()] = presence;
       }
     }
 
@@ -431,6 +431,11 @@ namespace discord
     return api::guild::get_members(m_owner, m_id, limit, after);
   }
 
+  Paginator<Member> Guild::iterate_members(uint32_t page_size, size_t read_ahead) const
+  {
+    return api::guild::iterate_members(m_owner, m_id, page_size, read_ahead);
+  }
+
   pplx::task<bool> Guild::add_member(Snowflake user_id, std::string access_token, std::string nick, std::vector<Role> roles, bool muted, bool deafened) const
   {
     return api::guild::add_member(m_owner, m_id, user_id, access_token, nick, roles, muted, deafened);
@@ -466,6 +471,11 @@ namespace discord
     return api::guild::get_bans(m_owner, m_id);
   }
 
+  Paginator<User> Guild::iterate_bans(uint32_t page_size, size_t read_ahead) const
+  {
+    return api::guild::iterate_bans(m_owner, m_id, page_size, read_ahead);
+  }
+
   pplx::task<bool> Guild::ban(Snowflake user_id, uint32_t delete_x_days) const
   {
     return api::guild::ban(m_owner, m_id, user_id, delete_x_days);
@@ -476,6 +486,26 @@ namespace discord
     return api::guild::unban(m_owner, m_id, user_id);
   }
 
+  BulkModeration Guild::bulk_ban(std::vector<Snowflake> user_ids, uint32_t delete_x_days, BulkModeration::ProgressHandler progress) const
+  {
+    return api::guild::bulk_ban(m_owner, m_id, std::move(user_ids), delete_x_days, progress);
+  }
+
+  BulkModeration Guild::bulk_kick(std::vector<Snowflake> user_ids, BulkModeration::ProgressHandler progress) const
+  {
+    return api::guild::bulk_kick(m_owner, m_id, std::move(user_ids), progress);
+  }
+
+  BulkModeration Guild::bulk_add_role(std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress) const
+  {
+    return api::guild::bulk_add_role(m_owner, m_id, std::move(user_ids), role_id, progress);
+  }
+
+  BulkModeration Guild::bulk_remove_role(std::vector<Snowflake> user_ids, Snowflake role_id, BulkModeration::ProgressHandler progress) const
+  {
+    return api::guild::bulk_remove_role(m_owner, m_id, std::move(user_ids), role_id, progress);
+  }
+
   pplx::task<std::vector<Role>> Guild::get_roles() const
   {
     return api::guild::get_roles(m_owner, m_id);
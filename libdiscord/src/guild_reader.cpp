@@ -0,0 +1,344 @@
+#include <cstring>
+
+#include "guild_reader.h"
+
+namespace discord
+{
+  const int GuildReader::ENVELOPE_DEPTH = 1;
+  const int GuildReader::GUILD_DEPTH = 2;
+  const int GuildReader::LIST_DEPTH = 3;
+  const int GuildReader::ELEMENT_DEPTH = 4;
+
+  bool GuildReader::Subtree::operator()(PooledDocument& document)
+  {
+    return reader.read_subtree(document);
+  }
+
+  GuildReader::List GuildReader::to_list(const char* key, rapidjson::SizeType length)
+  {
+    static const struct
+    {
+      const char* name;
+      List list;
+    } LISTS[] =
+    {
+      { "roles", List::Roles },
+      { "emojis", List::Emojis },
+      { "channels", List::Channels },
+      { "members", List::Members },
+      { "presences", List::Presences },
+      { "voice_states", List::VoiceStates }
+    };
+
+    for (const auto& entry : LISTS)
+    {
+      if (std::strlen(entry.name) == length && std::memcmp(entry.name, key, length) == 0)
+      {
+        return entry.list;
+      }
+    }
+
+    return List::None;
+  }
+
+  bool GuildReader::in_list() const
+  {
+    return m_target && m_list != List::None && m_depth == LIST_DEPTH;
+  }
+
+  void GuildReader::clear()
+  {
+    m_roles.clear();
+    m_emojis.clear();
+    m_channels.clear();
+    m_members.clear();
+    m_presences.clear();
+    m_voice_states.clear();
+  }
+
+  bool GuildReader::next()
+  {
+    return m_reader.IterativeParseNext<rapidjson::kParseInsituFlag>(m_stream, *this);
+  }
+
+  bool GuildReader::read_subtree(PooledDocument& document)
+  {
+    auto parent = m_target;
+    auto depth = m_depth;
+
+    //  The object was started before there was a document to send it to.
+    m_target = &document;
+    auto success = document.StartObject();
+
+    while (success && m_depth >= depth)
+    {
+      success = next();
+
+      if (success && m_pending == Pending::Element)
+      {
+        m_pending = Pending::None;
+        success = read_element();
+      }
+    }
+
+    m_target = parent;
+    return success;
+  }
+
+  bool GuildReader::read_element()
+  {
+    Subtree subtree{ *this };
+    auto& element = m_element_pool.populate(subtree);
+
+    if (!element.IsObject())
+    {
+      return false;
+    }
+
+    switch (m_list)
+    {
+    case List::Roles:
+      {
+        Role role(element);
+        m_roles[role.id()] = std::move(role);
+        break;
+      }
+    case List::Emojis:
+      {
+        Emoji emoji(element);
+        m_emojis[emoji.id()] = std::move(emoji);
+        break;
+      }
+    case List::Channels:
+      {
+        Channel chan(m_owner, element);
+        m_channels[chan.id()] = std::move(chan);
+        break;
+      }
+    case List::Members:
+      {
+        Member mem(m_owner, element);
+        m_members[mem.user().id()] = std::move(mem);
+        break;
+      }
+    case List::Presences:
+      {
+        Presence presence(m_owner, element);
+        m_presences[presence.user().id()] = std::move(presence);
+        break;
+      }
+    case List::VoiceStates:
+      m_voice_states.emplace_back(element);
+      break;
+    default: ;
+    }
+
+    return true;
+  }
+
+  void GuildReader::count_value()
+  {
+    if (in_list())
+    {
+      ++m_list_values;
+    }
+  }
+
+  GuildReader::GuildReader(ConnectionState* owner)
+    : m_owner(owner), m_stream(nullptr), m_target(nullptr), m_depth(0), m_in_data(false), m_pending(Pending::None), m_list(List::None), m_list_values(0)
+  {
+  }
+
+  std::unique_ptr<Guild> GuildReader::read(char* payload)
+  {
+    std::unique_ptr<Guild> guild;
+
+    m_stream = rapidjson::InsituStringStream(payload);
+    m_reader.IterativeParseInit();
+    m_target = nullptr;
+    m_depth = 0;
+    m_in_data = false;
+    m_pending = Pending::None;
+    m_list = List::None;
+    clear();
+
+    while (!m_reader.IterativeParseComplete())
+    {
+      if (!next())
+      {
+        clear();
+        return nullptr;
+      }
+
+      if (m_pending != Pending::Guild)
+      {
+        continue;
+      }
+
+      m_pending = Pending::None;
+
+      Subtree subtree{ *this };
+      auto& data = m_guild_pool.populate(subtree);
+
+      if (!data.IsObject())
+      {
+        clear();
+        return nullptr;
+      }
+
+      //  The lists are empty in the document, so the guild takes the objects that were built instead.
+      guild = std::make_unique<Guild>(m_owner, data);
+      guild->m_roles = std::move(m_roles);
+      guild->m_emojis = std::move(m_emojis);
+      guild->m_channels = std::move(m_channels);
+      guild->m_members = std::move(m_members);
+      guild->m_presences = std::move(m_presences);
+      guild->m_voice_states = std::move(m_voice_states);
+      clear();
+    }
+
+    return guild;
+  }
+
+  rapidjson::ParseErrorCode GuildReader::error() const
+  {
+    return m_reader.GetParseErrorCode();
+  }
+
+  size_t GuildReader::error_offset() const
+  {
+    return m_reader.GetErrorOffset();
+  }
+
+  bool GuildReader::Null()
+  {
+    count_value();
+    return !m_target || m_target->Null();
+  }
+
+  bool GuildReader::Bool(bool b)
+  {
+    count_value();
+    return !m_target || m_target->Bool(b);
+  }
+
+  bool GuildReader::Int(int i)
+  {
+    count_value();
+    return !m_target || m_target->Int(i);
+  }
+
+  bool GuildReader::Uint(unsigned u)
+  {
+    count_value();
+    return !m_target || m_target->Uint(u);
+  }
+
+  bool GuildReader::Int64(int64_t i)
+  {
+    count_value();
+    return !m_target || m_target->Int64(i);
+  }
+
+  bool GuildReader::Uint64(uint64_t u)
+  {
+    count_value();
+    return !m_target || m_target->Uint64(u);
+  }
+
+  bool GuildReader::Double(double d)
+  {
+    count_value();
+    return !m_target || m_target->Double(d);
+  }
+
+  bool GuildReader::RawNumber(const char* str, rapidjson::SizeType length, bool copy)
+  {
+    count_value();
+    return !m_target || m_target->RawNumber(str, length, copy);
+  }
+
+  bool GuildReader::String(const char* str, rapidjson::SizeType length, bool copy)
+  {
+    count_value();
+    return !m_target || m_target->String(str, length, copy);
+  }
+
+  bool GuildReader::StartObject()
+  {
+    //  Elements of a list are read into their own document once this event returns.
+    if (in_list())
+    {
+      ++m_depth;
+      m_pending = Pending::Element;
+      return true;
+    }
+
+    if (!m_target)
+    {
+      ++m_depth;
+
+      if (m_depth == GUILD_DEPTH && m_in_data)
+      {
+        m_pending = Pending::Guild;
+      }
+
+      return true;
+    }
+
+    ++m_depth;
+    return m_target->StartObject();
+  }
+
+  bool GuildReader::Key(const char* str, rapidjson::SizeType length, bool copy)
+  {
+    if (!m_target)
+    {
+      if (m_depth == ENVELOPE_DEPTH)
+      {
+        m_in_data = length == 1 && str[0] == 'd';
+      }
+
+      return true;
+    }
+
+    if (m_depth == GUILD_DEPTH)
+    {
+      m_list = to_list(str, length);
+    }
+
+    return m_target->Key(str, length, copy);
+  }
+
+  bool GuildReader::EndObject(rapidjson::SizeType member_count)
+  {
+    --m_depth;
+    return !m_target || m_target->EndObject(member_count);
+  }
+
+  bool GuildReader::StartArray()
+  {
+    count_value();
+    ++m_depth;
+
+    if (in_list())
+    {
+      m_list_values = 0;
+    }
+
+    return !m_target || m_target->StartArray();
+  }
+
+  bool GuildReader::EndArray(rapidjson::SizeType element_count)
+  {
+    //  Only the values that were passed on are in the document's copy of the list.
+    if (in_list())
+    {
+      element_count = m_list_values;
+      m_list = List::None;
+    }
+
+    --m_depth;
+    return !m_target || m_target->EndArray(element_count);
+  }
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cctype>
+#include <cpprest/http_client.h>
+
+#include "http_transport.h"
+
+namespace discord
+{
+  const std::string* HttpResponse::header(const std::string& name) const
+  {
+    auto found = headers.find(name);
+    return found == std::end(headers) ? nullptr : &found->second;
+  }
+
+  HttpTransportConfig::HttpTransportConfig()
+    : base_url("https://discordapp.com/api/v6"), timeout(std::chrono::milliseconds(30000)), clients(4), chunk_size(64 * 1024)
+  {
+  }
+
+  CpprestTransport::CpprestTransport(const HttpTransportConfig& config) : m_next_client(0)
+  {
+    web::http::client::http_client_config client_config;
+    client_config.set_timeout(config.timeout);
+    client_config.set_chunksize(config.chunk_size);
+
+    for (size_t i = 0; i < std::max<size_t>(config.clients, 1); ++i)
+    {
+      m_clients.push_back(std::make_unique<web::http::client::http_client>(utility::conversions::to_string_t(config.base_url), client_config));
+    }
+  }
+
+  CpprestTransport::~CpprestTransport()
+  {
+  }
+
+  pplx::task<HttpResponse> CpprestTransport::send(const HttpRequest& request)
+  {
+    web::http::method method;
+
+    switch (request.method)
+    {
+    case Method::GET:
+      method = web::http::methods::GET;
+      break;
+    case Method::POST:
+      method = web::http::methods::POST;
+      break;
+    case Method::PUT:
+      method = web::http::methods::PUT;
+      break;
+    case Method::PATCH:
+      method = web::http::methods::PATCH;
+      break;
+    case Method::DEL:
+      method = web::http::methods::DEL;
+      break;
+    }
+
+    web::http::http_request http_request(method);
+    http_request.set_request_uri(utility::conversions::to_string_t(request.path));
+    http_request.headers().add(U("Authorization"), utility::conversions::to_string_t(request.authorization));
+    http_request.headers().add(U("Content-Type"), U("application/json"));
+
+    if (!request.body.empty())
+    {
+      http_request.set_body(request.body);
+    }
+
+    auto& client = *m_clients[m_next_client++ % m_clients.size()];
+
+    return client.request(http_request).then([](web::http::http_response res)
+    {
+      auto response = std::make_shared<HttpResponse>();
+      response->status_code = res.status_code();
+
+      for (const auto& header : res.headers())
+      {
+        auto name = utility::conversions::to_utf8string(header.first);
+        std::transform(std::begin(name), std::end(name), std::begin(name), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        response->headers[name] = utility::conversions::to_utf8string(header.second);
+      }
+
+      //  Read straight into a string, which is moved along to be parsed in place.
+      return res.extract_utf8string(true).then([response](std::string body)
+      {
+        response->body = std::move(body);
+        return std::move(*response);
+      });
+    });
+  }
+
+  FakeTransport::FakeTransport(Handler handler) : m_handler(handler)
+  {
+  }
+
+  pplx::task<HttpResponse> FakeTransport::send(const HttpRequest& request)
+  {
+    Handler handler;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_requests.push_back(request);
+      handler = m_handler;
+    }
+
+    //  Answer asynchronously, like a real transport would.
+    return pplx::create_task([handler, request]()
+    {
+      if (!handler)
+      {
+        HttpResponse response;
+        response.status_code = 204;
+        return response;
+      }
+
+      return handler(request);
+    });
+  }
+
+  std::vector<HttpRequest> FakeTransport::requests() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_requests;
+  }
+}
@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "common.h"
+#include "identify_scheduler.h"
+
+namespace discord
+{
+  const std::chrono::milliseconds IdentifyScheduler::IDENTIFY_INTERVAL = std::chrono::milliseconds(5000);
+  const std::chrono::hours IdentifyScheduler::LIMIT_PERIOD = std::chrono::hours(24);
+
+  void IdentifyScheduler::set_limits(int max_concurrency, int total, int remaining, std::chrono::milliseconds reset_after)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto now = std::chrono::steady_clock::now();
+
+    m_max_concurrency = std::max(max_concurrency, 1);
+    m_bucket_ready.assign(m_max_concurrency, now);
+    m_total_identifies = total;
+    m_remaining_identifies = remaining;
+    m_limit_reset = now + reset_after;
+  }
+
+  int IdentifyScheduler::bucket(int shard) const
+  {
+    return shard % m_max_concurrency;
+  }
+
+  int IdentifyScheduler::max_concurrency() const
+  {
+    return m_max_concurrency;
+  }
+
+  std::chrono::milliseconds IdentifyScheduler::reserve(int shard)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    auto& ready = m_bucket_ready[bucket(shard)];
+    auto slot = std::max(now, ready);
+
+    if (m_remaining_identifies <= 0)
+    {
+      LOG(WARNING) << "Out of identifies, shard " << shard << " must wait for the session start limit to reset.";
+
+      //  Once the limit resets a new period starts with every identify available again.
+      slot = std::max(slot, m_limit_reset);
+      m_remaining_identifies = m_total_identifies;
+      m_limit_reset = slot + LIMIT_PERIOD;
+    }
+
+    --m_remaining_identifies;
+    ready = slot + IDENTIFY_INTERVAL;
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(slot - now);
+  }
+
+  IdentifyScheduler::IdentifyScheduler(TimerWheel& timers) : m_timers(timers)
+  {
+    set_limits(1, 1000, 1000, std::chrono::milliseconds(0));
+  }
+
+  void IdentifyScheduler::set_remote(RemoteDelay remote)
+  {
+    m_remote = remote;
+  }
+
+  TimerWheel::TimerId IdentifyScheduler::schedule(int shard, TimerWheel::Callback identify)
+  {
+    auto delay = reserve(shard);
+
+    //  Other processes share the same buckets, so also wait for whatever they have reserved.
+    if (m_remote)
+    {
+      try
+      {
+        delay = std::max(delay, m_remote(shard, max_concurrency()));
+      }
+      catch (const std::exception& e)
+      {
+        LOG(WARNING) << "Could not reserve an identify for shard " << shard << " with the cluster, identifying anyway: " << e.what();
+      }
+    }
+
+    if (delay.count() > 0)
+    {
+      LOG(DEBUG) << "Shard " << shard << " will identify in " << delay.count() << "ms.";
+    }
+
+    return m_timers.schedule(delay, identify);
+  }
+}
@@ -0,0 +1,72 @@
+#include "json_pool.h"
+
+namespace discord
+{
+  const size_t JsonPool::INITIAL_BUFFER_SIZE = 64 * 1024;
+  const size_t JsonPool::STACK_CAPACITY = 1024;
+
+  void JsonPool::rebuild()
+  {
+    m_document.reset();
+
+    m_value_allocator = std::make_unique<rapidjson::MemoryPoolAllocator<>>(m_value_buffer.data(), m_value_buffer.size());
+    m_stack_allocator = std::make_unique<rapidjson::MemoryPoolAllocator<>>(m_stack_buffer.data(), m_stack_buffer.size());
+    m_document = std::make_unique<PooledDocument>(m_value_allocator.get(), STACK_CAPACITY, m_stack_allocator.get());
+  }
+
+  void JsonPool::prepare()
+  {
+    //  If the last payload spilled into heap chunks, grow the buffers so the next one fits.
+    auto value_capacity = m_value_allocator->Capacity();
+    auto stack_capacity = m_stack_allocator->Capacity();
+
+    if (value_capacity > m_value_buffer.size() || stack_capacity > m_stack_buffer.size())
+    {
+      LOG(DEBUG) << "Growing JSON pool to " << value_capacity << " and " << stack_capacity << " bytes.";
+
+      m_document.reset();
+      m_value_allocator.reset();
+      m_stack_allocator.reset();
+
+      m_value_buffer.resize(std::max(value_capacity, m_value_buffer.size()) * 2);
+      m_stack_buffer.resize(std::max(stack_capacity, m_stack_buffer.size()) * 2);
+
+      rebuild();
+    }
+    else
+    {
+      //  Nothing in the old document is used anymore, so its memory can be handed out again.
+      m_document->SetNull();
+      m_value_allocator->Clear();
+      m_stack_allocator->Clear();
+    }
+  }
+
+  JsonPool::JsonPool(size_t initial_size) : m_value_buffer(initial_size), m_stack_buffer(initial_size), m_initial_size(initial_size)
+  {
+    rebuild();
+  }
+
+  void JsonPool::trim(size_t limit)
+  {
+    if (m_value_buffer.size() <= limit && m_stack_buffer.size() <= limit && m_value_allocator->Capacity() <= limit)
+    {
+      return;
+    }
+
+    m_document.reset();
+    m_value_allocator.reset();
+    m_stack_allocator.reset();
+
+    std::vector<char>(m_initial_size).swap(m_value_buffer);
+    std::vector<char>(m_initial_size).swap(m_stack_buffer);
+
+    rebuild();
+  }
+
+  PooledDocument& JsonPool::parse_insitu(char* data)
+  {
+    prepare();
+    return m_document->ParseInsitu(data);
+  }
+}
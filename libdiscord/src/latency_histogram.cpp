@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <vector>
+
+#include "latency_histogram.h"
+
+namespace discord
+{
+  const size_t LatencyHistogram::WINDOW;
+  const std::array<uint32_t, LATENCY_BUCKET_COUNT> LatencyHistogram::BUCKET_BOUNDS =
+  {
+    { 25, 50, 75, 100, 150, 250, 500, 1000, 2500, UINT32_MAX }
+  };
+
+  size_t LatencyHistogram::bucket(uint32_t sample)
+  {
+    return std::lower_bound(std::begin(BUCKET_BOUNDS), std::end(BUCKET_BOUNDS), sample) - std::begin(BUCKET_BOUNDS);
+  }
+
+  LatencyHistogram::LatencyHistogram() : m_samples(), m_buckets(), m_next(0), m_count(0), m_last(0)
+  {
+  }
+
+  void LatencyHistogram::record(std::chrono::milliseconds latency)
+  {
+    auto sample = static_cast<uint32_t>(std::max(latency.count(), static_cast<std::chrono::milliseconds::rep>(0)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_count == WINDOW)
+    {
+      --m_buckets[bucket(m_samples[m_next])];
+    }
+    else
+    {
+      ++m_count;
+    }
+
+    m_samples[m_next] = sample;
+    ++m_buckets[bucket(sample)];
+    m_next = (m_next + 1) % WINDOW;
+    m_last = sample;
+  }
+
+  LatencyStats LatencyHistogram::stats() const
+  {
+    LatencyStats stats;
+    std::vector<uint32_t> sorted;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      if (m_count == 0)
+      {
+        return stats;
+      }
+
+      sorted.assign(std::begin(m_samples), std::begin(m_samples) + m_count);
+      stats.histogram = m_buckets;
+      stats.last = std::chrono::milliseconds(m_last);
+    }
+
+    std::sort(std::begin(sorted), std::end(sorted));
+
+    uint64_t total = 0;
+    for (auto sample : sorted)
+    {
+      total += sample;
+    }
+
+    stats.samples = sorted.size();
+    stats.average = std::chrono::milliseconds(total / sorted.size());
+    stats.p50 = std::chrono::milliseconds(sorted[(sorted.size() - 1) / 2]);
+    stats.p99 = std::chrono::milliseconds(sorted[(sorted.size() - 1) * 99 / 100]);
+    stats.max = std::chrono::milliseconds(sorted.back());
+
+    return stats;
+  }
+}
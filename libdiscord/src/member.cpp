@@ -26,7 +26,7 @@ namespace discord
     {
       for (const auto& role_id : found->value.GetArray())
       {
-        m_roles.emplace_back(role_id.GetString());
+        m_roles.emplace_back(role_id);
       }
     }
 
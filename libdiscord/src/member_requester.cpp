@@ -0,0 +1,222 @@
+#include <algorithm>
+
+#include "discord_exception.h"
+#include "member_requester.h"
+
+namespace discord
+{
+  const size_t MemberRequester::GUILDS_PER_BATCH = 50;
+  const std::chrono::milliseconds MemberRequester::CHUNK_TIMEOUT = std::chrono::milliseconds(30000);
+
+  void MemberRequester::send_next(int shard)
+  {
+    auto& waiting = m_waiting[shard];
+
+    if (!m_in_flight[shard].empty() || waiting.empty())
+    {
+      return;
+    }
+
+    auto nonce = std::to_string(m_next_nonce++);
+    auto& batch = m_batches[nonce] = std::move(waiting.front());
+    waiting.pop_front();
+
+    m_in_flight[shard] = nonce;
+    batch.timeout = TimerWheel::INVALID_TIMER;
+    reset_timeout(nonce, batch);
+
+    LOG(DEBUG) << "Requesting members of " << batch.guild_ids.size() << " guilds on shard " << shard << " with nonce " << nonce << ".";
+
+    m_sender(shard, batch.guild_ids, nonce);
+  }
+
+  void MemberRequester::reset_timeout(const std::string& nonce, Batch& batch)
+  {
+    //  The mutex is held, which the timeout takes. One that already fired sees it was replaced and does nothing.
+    m_timers.cancel_pending(batch.timeout);
+
+    auto timeout = std::make_shared<TimerWheel::TimerId>();
+    batch.timeout = *timeout = m_timers.schedule(CHUNK_TIMEOUT, [this, nonce, timeout]()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = m_batches.find(nonce);
+
+      if (found != std::end(m_batches) && found->second.timeout == *timeout)
+      {
+        LOG(WARNING) << "Gave up on member request " << nonce << " after not receiving a chunk for " << CHUNK_TIMEOUT.count() << "ms.";
+        finish(nonce);
+      }
+    });
+  }
+
+  void MemberRequester::finish(const std::string& nonce)
+  {
+    auto found = m_batches.find(nonce);
+    auto& batch = found->second;
+    auto shard = batch.shard;
+
+    m_timers.cancel_pending(batch.timeout);
+
+    if (--batch.request->batches_left == 0)
+    {
+      batch.request->done.set(batch.request->members);
+    }
+
+    m_batches.erase(found);
+    m_in_flight[shard].clear();
+    send_next(shard);
+  }
+
+  MemberRequester::MemberRequester(TimerWheel& timers) : m_timers(timers), m_shards(0), m_first_shard(0), m_last_shard(0), m_next_nonce(1)
+  {
+  }
+
+  MemberRequester::~MemberRequester()
+  {
+    //  Timeouts are cancelled once the mutex is released, they take it. Any that are running find nothing left.
+    std::vector<TimerWheel::TimerId> timeouts;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto& nonce_batch : m_batches)
+      {
+        timeouts.push_back(nonce_batch.second.timeout);
+        nonce_batch.second.request->done.set_exception(DiscordException("Member request was cancelled."));
+      }
+
+      for (auto& waiting : m_waiting)
+      {
+        for (auto& batch : waiting)
+        {
+          batch.request->done.set_exception(DiscordException("Member request was cancelled."));
+        }
+      }
+
+      m_batches.clear();
+      m_waiting.clear();
+    }
+
+    for (auto timeout : timeouts)
+    {
+      m_timers.cancel(timeout);
+    }
+  }
+
+  void MemberRequester::set_sender(int shards, int first_shard, int last_shard, Sender sender)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_shards = shards;
+    m_first_shard = first_shard;
+    m_last_shard = last_shard;
+    m_sender = sender;
+    m_waiting.resize(shards);
+    m_in_flight.resize(shards);
+  }
+
+  pplx::task<uint32_t> MemberRequester::request(const std::vector<Snowflake>& guild_ids)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_sender)
+    {
+      LOG(ERROR) << "Tried to request members before connecting.";
+      throw DiscordException("Tried to request members before connecting.");
+    }
+
+    auto request = std::make_shared<Request>();
+    request->batches_left = 0;
+    request->members = 0;
+
+    if (guild_ids.empty())
+    {
+      return pplx::task_from_result<uint32_t>(0);
+    }
+
+    //  Split the guilds by the shard that they belong to.
+    std::vector<std::vector<Snowflake>> by_shard(m_shards);
+
+    for (const auto& id : guild_ids)
+    {
+      auto shard = static_cast<int>((id.id() >> 22) % m_shards);
+
+      if (shard < m_first_shard || shard >= m_last_shard)
+      {
+        LOG(WARNING) << "Not requesting members of guild " << id.to_string() << ", its shard " << shard << " runs in another process.";
+        continue;
+      }
+
+      by_shard[shard].push_back(id);
+    }
+
+    std::vector<int> shards;
+
+    for (auto shard = 0; shard < m_shards; ++shard)
+    {
+      auto& ids = by_shard[shard];
+
+      for (size_t first = 0; first < ids.size(); first += GUILDS_PER_BATCH)
+      {
+        Batch batch;
+        batch.request = request;
+        batch.shard = shard;
+        batch.guild_ids.assign(std::begin(ids) + first, std::begin(ids) + std::min(first + GUILDS_PER_BATCH, ids.size()));
+        batch.guilds_left = batch.guild_ids.size();
+        batch.timeout = TimerWheel::INVALID_TIMER;
+
+        m_waiting[shard].push_back(std::move(batch));
+        ++request->batches_left;
+      }
+
+      if (!ids.empty())
+      {
+        shards.push_back(shard);
+      }
+    }
+
+    if (shards.empty())
+    {
+      return pplx::task_from_result<uint32_t>(0);
+    }
+
+    //  Only start sending once every batch is counted, so the request can't finish early.
+    for (auto shard : shards)
+    {
+      send_next(shard);
+    }
+
+    return pplx::create_task(request->done);
+  }
+
+  void MemberRequester::on_chunk(Snowflake guild_id, const std::string& nonce, uint32_t chunk_count, uint32_t members)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto found = m_batches.find(nonce);
+
+    //  Chunks for something else, like a request that already timed out.
+    if (found == std::end(m_batches))
+    {
+      return;
+    }
+
+    auto& batch = found->second;
+    batch.request->members += members;
+
+    auto chunks = batch.chunks_left.find(guild_id);
+
+    if (chunks == std::end(batch.chunks_left))
+    {
+      chunks = batch.chunks_left.emplace(guild_id, chunk_count).first;
+    }
+
+    if (chunks->second > 0 && --chunks->second == 0 && --batch.guilds_left == 0)
+    {
+      finish(nonce);
+      return;
+    }
+
+    reset_timeout(nonce, batch);
+  }
+}
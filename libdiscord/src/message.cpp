@@ -59,7 +59,7 @@ namespace discord
       }
       else
       {
-        m_nonce = Snowflake(found->value.GetString());
+        m_nonce = Snowflake(found->value);
       }
     }
   }
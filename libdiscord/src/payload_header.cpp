@@ -0,0 +1,752 @@
+#include <cstring>
+
+#include "etf.h"
+#include "payload_header.h"
+
+namespace discord
+{
+  namespace
+  {
+    bool key_is(const char* key, size_t length, const char* name, size_t name_length)
+    {
+      return length == name_length && memcmp(key, name, length) == 0;
+    }
+
+    /** Reads a snowflake from its decimal digits. */
+    bool parse_id(const char* digits, size_t length, uint64_t& id)
+    {
+      if (length == 0 || length > 20)
+      {
+        return false;
+      }
+
+      uint64_t value = 0;
+      for (size_t i = 0; i < length; ++i)
+      {
+        if (digits[i] < '0' || digits[i] > '9')
+        {
+          return false;
+        }
+
+        value = value * 10 + static_cast<uint64_t>(digits[i] - '0');
+      }
+
+      id = value;
+      return true;
+    }
+
+    /** Checks if a scan has found everything that is needed, so the rest can be left to the real parse.
+     *
+     * @param header The fields found so far.
+     * @param need_guild Whether the guild of a dispatch is needed.
+     */
+    bool header_complete(const PayloadHeader& header, bool need_guild)
+    {
+      //  Anything but a dispatch gets the full parse, so nothing else about it matters.
+      if (header.op > 0)
+      {
+        return true;
+      }
+
+      if (header.op < 0 || header.seq < 0 || !header.event)
+      {
+        return false;
+      }
+
+      if (!need_guild || header.guild_id != 0)
+      {
+        return true;
+      }
+
+      //  Guild events carry the guild's own id instead of a guild_id.
+      return header.id != 0 && (key_is(header.event, header.event_length, "GUILD_CREATE", 12)
+        || key_is(header.event, header.event_length, "GUILD_UPDATE", 12) || key_is(header.event, header.event_length, "GUILD_DELETE", 12));
+    }
+
+    /** Walks JSON text just far enough to find the header fields that are needed. */
+    class JsonScanner
+    {
+      const char* m_pos;
+      const char* m_end;
+      bool m_need_guild;
+
+      void skip_whitespace()
+      {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+        {
+          ++m_pos;
+        }
+      }
+
+      bool expect(char c)
+      {
+        skip_whitespace();
+
+        if (m_pos < m_end && *m_pos == c)
+        {
+          ++m_pos;
+          return true;
+        }
+
+        return false;
+      }
+
+      bool peek(char c)
+      {
+        skip_whitespace();
+        return m_pos < m_end && *m_pos == c;
+      }
+
+      /** Reads a string without unescaping it. The returned text is the raw contents between the quotes. */
+      bool read_string(const char*& str, size_t& length)
+      {
+        if (!expect('"'))
+        {
+          return false;
+        }
+
+        str = m_pos;
+
+        while (m_pos < m_end && *m_pos != '"')
+        {
+          //  Skip whatever is escaped, which might be a quote.
+          m_pos += *m_pos == '\\' ? 2 : 1;
+        }
+
+        if (m_pos >= m_end)
+        {
+          return false;
+        }
+
+        length = m_pos - str;
+        ++m_pos;
+        return true;
+      }
+
+      bool read_integer(int64_t& value)
+      {
+        skip_whitespace();
+
+        auto negative = m_pos < m_end && *m_pos == '-';
+        if (negative)
+        {
+          ++m_pos;
+        }
+
+        if (m_pos >= m_end || *m_pos < '0' || *m_pos > '9')
+        {
+          return false;
+        }
+
+        value = 0;
+        while (m_pos < m_end && *m_pos >= '0' && *m_pos <= '9')
+        {
+          value = value * 10 + (*m_pos - '0');
+          ++m_pos;
+        }
+
+        if (negative)
+        {
+          value = -value;
+        }
+
+        return true;
+      }
+
+      bool skip_value()
+      {
+        skip_whitespace();
+
+        if (m_pos >= m_end)
+        {
+          return false;
+        }
+
+        if (*m_pos == '"')
+        {
+          const char* str;
+          size_t length;
+          return read_string(str, length);
+        }
+
+        if (*m_pos == '{' || *m_pos == '[')
+        {
+          size_t depth = 0;
+
+          while (m_pos < m_end)
+          {
+            switch (*m_pos)
+            {
+            case '"':
+              {
+                const char* str;
+                size_t length;
+                if (!read_string(str, length))
+                {
+                  return false;
+                }
+                continue;
+              }
+            case '{':
+            case '[':
+              ++depth;
+              break;
+            case '}':
+            case ']':
+              if (--depth == 0)
+              {
+                ++m_pos;
+                return true;
+              }
+              break;
+            }
+
+            ++m_pos;
+          }
+
+          return false;
+        }
+
+        //  A number or a literal, which both end at the next delimiter.
+        while (m_pos < m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']')
+        {
+          ++m_pos;
+        }
+
+        return true;
+      }
+
+      bool read_id(uint64_t& id)
+      {
+        if (!peek('"'))
+        {
+          return skip_value();
+        }
+
+        const char* str;
+        size_t length;
+        if (!read_string(str, length))
+        {
+          return false;
+        }
+
+        parse_id(str, length, id);
+        return true;
+      }
+
+      bool scan_data(PayloadHeader& header)
+      {
+        if (!peek('{'))
+        {
+          return skip_value();
+        }
+
+        ++m_pos;
+
+        if (expect('}'))
+        {
+          return true;
+        }
+
+        do
+        {
+          const char* key;
+          size_t length;
+          if (!read_string(key, length) || !expect(':'))
+          {
+            return false;
+          }
+
+          bool ok;
+          if (key_is(key, length, "guild_id", 8))
+          {
+            ok = read_id(header.guild_id);
+          }
+          else if (key_is(key, length, "id", 2))
+          {
+            ok = read_id(header.id);
+          }
+          else
+          {
+            ok = skip_value();
+          }
+
+          if (!ok)
+          {
+            return false;
+          }
+
+          if (header_complete(header, m_need_guild))
+          {
+            return true;
+          }
+        } while (expect(','));
+
+        return expect('}');
+      }
+    public:
+      JsonScanner(const char* data, size_t size, bool need_guild) : m_pos(data), m_end(data + size), m_need_guild(need_guild) {}
+
+      bool scan(PayloadHeader& header)
+      {
+        if (!expect('{'))
+        {
+          return false;
+        }
+
+        if (expect('}'))
+        {
+          return true;
+        }
+
+        do
+        {
+          const char* key;
+          size_t length;
+          if (!read_string(key, length) || !expect(':'))
+          {
+            return false;
+          }
+
+          bool ok;
+          if (key_is(key, length, "op", 2))
+          {
+            int64_t op;
+            ok = read_integer(op);
+            header.op = static_cast<int>(op);
+          }
+          else if (key_is(key, length, "s", 1))
+          {
+            ok = peek('n') ? skip_value() : read_integer(header.seq);
+          }
+          else if (key_is(key, length, "t", 1))
+          {
+            ok = peek('"') ? read_string(header.event, header.event_length) : skip_value();
+          }
+          else if (key_is(key, length, "d", 1))
+          {
+            ok = scan_data(header);
+          }
+          else
+          {
+            ok = skip_value();
+          }
+
+          if (!ok)
+          {
+            return false;
+          }
+
+          if (header_complete(header, m_need_guild))
+          {
+            return true;
+          }
+        } while (expect(','));
+
+        return expect('}');
+      }
+    };
+
+    /** Walks ETF data just far enough to find the header fields that are needed. Lengths are all up front, so
+     *  skipping a term never has to look at its contents unless it is a container.
+     */
+    class EtfScanner
+    {
+      const uint8_t* m_pos;
+      const uint8_t* m_end;
+      bool m_need_guild;
+
+      bool require(size_t bytes) const
+      {
+        return static_cast<size_t>(m_end - m_pos) >= bytes;
+      }
+
+      uint32_t read_length(size_t bytes)
+      {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+          value = (value << 8) | *m_pos++;
+        }
+
+        return value;
+      }
+
+      /** Reads an atom or binary as text. */
+      bool read_text(const char*& text, size_t& length)
+      {
+        if (!require(1))
+        {
+          return false;
+        }
+
+        size_t length_bytes;
+
+        switch (*m_pos++)
+        {
+        case etf::Atom:
+        case etf::AtomUtf8:
+        case etf::String:
+          length_bytes = 2;
+          break;
+        case etf::SmallAtom:
+        case etf::SmallAtomUtf8:
+          length_bytes = 1;
+          break;
+        case etf::Binary:
+          length_bytes = 4;
+          break;
+        default:
+          return false;
+        }
+
+        if (!require(length_bytes))
+        {
+          return false;
+        }
+
+        length = read_length(length_bytes);
+
+        if (!require(length))
+        {
+          return false;
+        }
+
+        text = reinterpret_cast<const char*>(m_pos);
+        m_pos += length;
+        return true;
+      }
+
+      /** Reads an integer term. Returns false without moving if the term is not an integer. */
+      bool read_integer(uint64_t& value)
+      {
+        if (!require(1))
+        {
+          return false;
+        }
+
+        auto start = m_pos;
+
+        switch (*m_pos++)
+        {
+        case etf::SmallInteger:
+          if (require(1))
+          {
+            value = *m_pos++;
+            return true;
+          }
+          break;
+        case etf::Integer:
+          if (require(4))
+          {
+            value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(read_length(4))));
+            return true;
+          }
+          break;
+        case etf::SmallBig:
+          if (require(2))
+          {
+            size_t length = *m_pos++;
+            auto negative = *m_pos++ != 0;
+
+            if (length <= 8 && !negative && require(length))
+            {
+              value = 0;
+              for (size_t i = 0; i < length; ++i)
+              {
+                value |= static_cast<uint64_t>(m_pos[i]) << (8 * i);
+              }
+
+              m_pos += length;
+              return true;
+            }
+          }
+          break;
+        }
+
+        m_pos = start;
+        return false;
+      }
+
+      bool skip_term()
+      {
+        if (!require(1))
+        {
+          return false;
+        }
+
+        size_t skip;
+        uint32_t elements;
+
+        switch (*m_pos++)
+        {
+        case etf::SmallInteger:
+          skip = 1;
+          break;
+        case etf::Integer:
+          skip = 4;
+          break;
+        case etf::NewFloat:
+          skip = 8;
+          break;
+        case etf::Float:
+          skip = 31;
+          break;
+        case etf::Atom:
+        case etf::AtomUtf8:
+        case etf::String:
+          if (!require(2))
+          {
+            return false;
+          }
+          skip = read_length(2);
+          break;
+        case etf::SmallAtom:
+        case etf::SmallAtomUtf8:
+          if (!require(1))
+          {
+            return false;
+          }
+          skip = read_length(1);
+          break;
+        case etf::Binary:
+          if (!require(4))
+          {
+            return false;
+          }
+          skip = read_length(4);
+          break;
+        case etf::SmallBig:
+          if (!require(1))
+          {
+            return false;
+          }
+          skip = read_length(1) + 1;
+          break;
+        case etf::LargeBig:
+          if (!require(4))
+          {
+            return false;
+          }
+          skip = static_cast<size_t>(read_length(4)) + 1;
+          break;
+        case etf::Nil:
+          return true;
+        case etf::SmallTuple:
+          if (!require(1))
+          {
+            return false;
+          }
+          elements = read_length(1);
+          return skip_terms(elements);
+        case etf::LargeTuple:
+          if (!require(4))
+          {
+            return false;
+          }
+          elements = read_length(4);
+          return skip_terms(elements);
+        case etf::List:
+          if (!require(4))
+          {
+            return false;
+          }
+          elements = read_length(4);
+
+          //  The tail of the list is one more term.
+          return skip_terms(elements) && skip_term();
+        case etf::Map:
+          if (!require(4))
+          {
+            return false;
+          }
+          elements = read_length(4);
+          return elements <= UINT32_MAX / 2 && skip_terms(elements * 2);
+        default:
+          return false;
+        }
+
+        if (!require(skip))
+        {
+          return false;
+        }
+
+        m_pos += skip;
+        return true;
+      }
+
+      bool skip_terms(uint32_t count)
+      {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+          if (!skip_term())
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      bool read_id(uint64_t& id)
+      {
+        if (read_integer(id))
+        {
+          return true;
+        }
+
+        if (require(1) && *m_pos == etf::Binary)
+        {
+          const char* digits;
+          size_t length;
+          if (!read_text(digits, length))
+          {
+            return false;
+          }
+
+          parse_id(digits, length, id);
+          return true;
+        }
+
+        return skip_term();
+      }
+
+      bool scan_data(PayloadHeader& header)
+      {
+        if (!require(5) || *m_pos != etf::Map)
+        {
+          return skip_term();
+        }
+
+        ++m_pos;
+        auto pairs = read_length(4);
+
+        for (uint32_t i = 0; i < pairs; ++i)
+        {
+          const char* key;
+          size_t length;
+          if (!read_text(key, length))
+          {
+            return false;
+          }
+
+          bool ok;
+          if (key_is(key, length, "guild_id", 8))
+          {
+            ok = read_id(header.guild_id);
+          }
+          else if (key_is(key, length, "id", 2))
+          {
+            ok = read_id(header.id);
+          }
+          else
+          {
+            ok = skip_term();
+          }
+
+          if (!ok)
+          {
+            return false;
+          }
+
+          if (header_complete(header, m_need_guild))
+          {
+            return true;
+          }
+        }
+
+        return true;
+      }
+    public:
+      EtfScanner(const char* data, size_t size, bool need_guild)
+        : m_pos(reinterpret_cast<const uint8_t*>(data)), m_end(reinterpret_cast<const uint8_t*>(data) + size), m_need_guild(need_guild) {}
+
+      bool scan(PayloadHeader& header)
+      {
+        if (!require(6) || *m_pos++ != etf::Version || *m_pos++ != etf::Map)
+        {
+          return false;
+        }
+
+        auto pairs = read_length(4);
+
+        for (uint32_t i = 0; i < pairs; ++i)
+        {
+          const char* key;
+          size_t length;
+          if (!read_text(key, length))
+          {
+            return false;
+          }
+
+          bool ok = true;
+          if (key_is(key, length, "op", 2))
+          {
+            uint64_t op;
+            ok = read_integer(op);
+            header.op = static_cast<int>(op);
+          }
+          else if (key_is(key, length, "s", 1))
+          {
+            uint64_t seq;
+            if (read_integer(seq))
+            {
+              header.seq = static_cast<int64_t>(seq);
+            }
+            else
+            {
+              ok = skip_term();
+            }
+          }
+          else if (key_is(key, length, "t", 1))
+          {
+            //  The event name is an atom, unless there is no event and it is the nil atom.
+            auto start = m_pos;
+            ok = read_text(header.event, header.event_length);
+
+            if (ok && key_is(header.event, header.event_length, "nil", 3))
+            {
+              header.event = nullptr;
+              header.event_length = 0;
+            }
+            else if (!ok)
+            {
+              m_pos = start;
+              ok = skip_term();
+            }
+          }
+          else if (key_is(key, length, "d", 1))
+          {
+            ok = scan_data(header);
+          }
+          else
+          {
+            ok = skip_term();
+          }
+
+          if (!ok)
+          {
+            return false;
+          }
+
+          if (header_complete(header, m_need_guild))
+          {
+            return true;
+          }
+        }
+
+        return true;
+      }
+    };
+  }
+
+  bool scan_json_header(const char* data, size_t size, PayloadHeader& header, bool need_guild)
+  {
+    return JsonScanner(data, size, need_guild).scan(header);
+  }
+
+  bool scan_etf_header(const char* data, size_t size, PayloadHeader& header, bool need_guild)
+  {
+    return EtfScanner(data, size, need_guild).scan(header);
+  }
+}
@@ -0,0 +1,157 @@
+#include "purge.h"
+#include "api/channel_api.h"
+#include "connection_state.h"
+#include "discord_exception.h"
+#include "message.h"
+
+namespace discord
+{
+  const size_t PurgeOptions::BULK_DELETE_LIMIT = 100;
+  const std::chrono::milliseconds PurgeOptions::BULK_DELETE_MAX_AGE = std::chrono::hours(14 * 24) - std::chrono::minutes(10);
+
+  PurgeOptions::PurgeOptions() : limit(0), before(0), after(0), read_ahead(2)
+  {
+  }
+
+  namespace
+  {
+    /** A purge that is running. */
+    struct Purge
+    {
+      ConnectionState* conn;
+      Snowflake channel_id;
+      PurgeOptions options;
+      Paginator<Message> pages;
+      PurgeResult result;
+
+      Purge(ConnectionState* conn, Snowflake channel_id, PurgeOptions options)
+        : conn(conn), channel_id(channel_id), options(options),
+          pages(api::channel::iterate_messages(conn, channel_id, SearchMethod::Before, options.before, PurgeOptions::BULK_DELETE_LIMIT, options.read_ahead))
+      {
+      }
+    };
+
+    /** Deletes messages with a single bulk delete, or a normal delete if there is only one.
+     *
+     * @return How many of the messages were deleted.
+     */
+    pplx::task<size_t> remove_batch(ConnectionState* conn, Snowflake channel_id, std::vector<Snowflake> message_ids)
+    {
+      auto count = message_ids.size();
+      auto removed = count == 1
+        ? api::channel::remove_message(conn, channel_id, message_ids.front())
+        : api::channel::bulk_remove_messages(conn, channel_id, message_ids);
+
+      return removed.then([count](pplx::task<bool> task) -> size_t
+      {
+        try
+        {
+          return task.get() ? count : 0;
+        }
+        catch (const std::exception& e)
+        {
+          LOG(WARNING) << "Could not delete " << count << " messages while purging: " << e.what();
+          return 0;
+        }
+      });
+    }
+
+    /** Deletes the matching messages of the next page, then moves on to the page after it. */
+    pplx::task<PurgeResult> purge_page(std::shared_ptr<Purge> purge)
+    {
+      return purge->pages.next().then([purge](std::vector<Message> page) -> pplx::task<PurgeResult>
+      {
+        const auto& options = purge->options;
+        auto bulk_cutoff = Snowflake::from_time(std::chrono::system_clock::now() - PurgeOptions::BULK_DELETE_MAX_AGE);
+        std::vector<pplx::task<size_t>> deletes;
+        auto finished = page.empty();
+
+        //  Pages hold at most BULK_DELETE_LIMIT messages, so one bulk delete covers a page. Nothing is
+        //  kept for the next page, where the oldest of these could age past the bulk delete limit.
+        std::vector<Snowflake> bulk;
+
+        //  Pages go from newest to oldest, so the first message past a bound ends the purge.
+        for (const auto& message : page)
+        {
+          if (message.id() <= options.after.id())
+          {
+            finished = true;
+            break;
+          }
+
+          ++purge->result.scanned;
+
+          if (options.filter && !options.filter(message))
+          {
+            continue;
+          }
+
+          ++purge->result.matched;
+
+          if (message.id() < bulk_cutoff)
+          {
+            //  Too old to bulk delete. These queue up behind the single delete route's rate limit.
+            deletes.push_back(remove_batch(purge->conn, purge->channel_id, { message.id() }));
+          }
+          else
+          {
+            bulk.push_back(message.id());
+          }
+
+          if (options.limit != 0 && purge->result.matched >= options.limit)
+          {
+            finished = true;
+            break;
+          }
+        }
+
+        if (!bulk.empty())
+        {
+          deletes.push_back(remove_batch(purge->conn, purge->channel_id, std::move(bulk)));
+        }
+
+        if (finished)
+        {
+          purge->pages.stop();
+        }
+
+        //  The next pages are fetched while this page's messages are deleted.
+        auto deleted = deletes.empty()
+          ? pplx::task_from_result(std::vector<size_t>())
+          : pplx::when_all(std::begin(deletes), std::end(deletes));
+
+        return deleted.then([purge, finished](std::vector<size_t> counts) -> pplx::task<PurgeResult>
+        {
+          for (auto count : counts)
+          {
+            purge->result.deleted += count;
+          }
+
+          if (finished)
+          {
+            LOG(INFO) << "Purged " << purge->result.deleted << " of " << purge->result.matched << " matching messages from channel " << purge->channel_id.to_string() << ".";
+            return pplx::task_from_result(purge->result);
+          }
+
+          return purge_page(purge);
+        });
+      });
+    }
+  }
+
+  namespace api
+  {
+    namespace channel
+    {
+      pplx::task<PurgeResult> purge_messages(ConnectionState* conn, Snowflake channel_id, PurgeOptions options)
+      {
+        if (options.after.id() != 0 && options.before.id() != 0 && !(options.after < options.before))
+        {
+          throw DiscordException("Purge range is empty, after must be older than before.");
+        }
+
+        return purge_page(std::make_shared<Purge>(conn, channel_id, options));
+      }
+    }
+  }
+}
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <iterator>
+
+#include "rate_limiter.h"
+
+namespace discord
+{
+  const size_t RateLimiter::SHARDS = 16;
+  const std::chrono::milliseconds RateLimiter::IDLE_TIMEOUT = std::chrono::milliseconds(300000);
+
+  namespace
+  {
+    /** How long from now until a time point, rounded up so a timer never fires early. */
+    std::chrono::milliseconds until(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::time_point now)
+    {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(when - now) + std::chrono::milliseconds(1);
+    }
+  }
+
+  size_t RateLimiter::shard_of(uint64_t major) const
+  {
+    //  The low bits of a snowflake are a per-process counter, mix in the timestamp as well.
+    return static_cast<size_t>((major ^ (major >> 22)) % SHARDS);
+  }
+
+  std::shared_ptr<RateLimiter::Bucket> RateLimiter::make_bucket(const std::string& name)
+  {
+    //  Nothing is known about a new bucket, so it sends a single request to find out its limits.
+    auto bucket = std::make_shared<Bucket>();
+    bucket->name = name;
+    bucket->limit = -1;
+    bucket->remaining = 1;
+    bucket->reset = std::chrono::steady_clock::now();
+    bucket->window = std::chrono::milliseconds(0);
+    bucket->in_flight = 0;
+    bucket->timer = TimerWheel::INVALID_TIMER;
+    bucket->last_used = bucket->reset;
+
+    return bucket;
+  }
+
+  std::shared_ptr<RateLimiter::Bucket>& RateLimiter::find_route(Shard& shard, const Route& route)
+  {
+    auto& bucket = shard.routes[route];
+
+    if (!bucket)
+    {
+      bucket = make_bucket("");
+    }
+
+    return bucket;
+  }
+
+  void RateLimiter::release(size_t shard, const std::shared_ptr<Bucket>& bucket, std::vector<Start>& ready)
+  {
+    auto now = std::chrono::steady_clock::now();
+
+    while (!bucket->waiting.empty() && !m_stopping)
+    {
+      auto global_reset = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_global_reset.load()));
+
+      if (global_reset > now)
+      {
+        std::lock_guard<std::mutex> lock(m_global_mutex);
+
+        if (m_global_timer == TimerWheel::INVALID_TIMER)
+        {
+          m_global_timer = m_timers.schedule(until(global_reset, now), [this]() { pump_all(); });
+        }
+
+        return;
+      }
+
+      if (bucket->remaining <= 0)
+      {
+        if (bucket->reset > now)
+        {
+          if (bucket->timer == TimerWheel::INVALID_TIMER)
+          {
+            std::weak_ptr<Bucket> weak = bucket;
+            bucket->timer = m_timers.schedule(until(bucket->reset, now), [this, shard, weak]() { pump(shard, weak); });
+          }
+
+          return;
+        }
+
+        if (bucket->limit > 0)
+        {
+          bucket->remaining = bucket->limit;
+          bucket->reset = now + bucket->window;
+        }
+        else if (bucket->in_flight > 0)
+        {
+          //  The limit is still unknown, wait for the response of the request that is finding out.
+          return;
+        }
+        else
+        {
+          bucket->remaining = 1;
+        }
+      }
+
+      --bucket->remaining;
+      ++bucket->in_flight;
+      ready.push_back(std::move(bucket->waiting.front()));
+      bucket->waiting.pop_front();
+    }
+  }
+
+  void RateLimiter::pump(size_t shard, std::weak_ptr<Bucket> weak)
+  {
+    std::vector<Start> ready;
+
+    {
+      std::lock_guard<std::mutex> lock(m_shards[shard].mutex);
+      auto bucket = weak.lock();
+
+      //  Dropped, or replaced by the route's real bucket.
+      if (!bucket)
+      {
+        return;
+      }
+
+      bucket->timer = TimerWheel::INVALID_TIMER;
+      release(shard, bucket, ready);
+    }
+
+    for (auto& start : ready)
+    {
+      start();
+    }
+  }
+
+  void RateLimiter::pump_all()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_global_mutex);
+      m_global_timer = TimerWheel::INVALID_TIMER;
+    }
+
+    for (size_t index = 0; index < SHARDS; ++index)
+    {
+      std::vector<Start> ready;
+
+      {
+        auto& shard = m_shards[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        for (auto& route_bucket : shard.routes)
+        {
+          release(index, route_bucket.second, ready);
+        }
+      }
+
+      for (auto& start : ready)
+      {
+        start();
+      }
+    }
+  }
+
+  void RateLimiter::sweep()
+  {
+    auto now = std::chrono::steady_clock::now();
+
+    auto idle = [now](const std::shared_ptr<Bucket>& bucket)
+    {
+      return bucket->waiting.empty() && bucket->in_flight == 0 && bucket->reset <= now && now - bucket->last_used > IDLE_TIMEOUT;
+    };
+
+    for (size_t index = 0; index < SHARDS; ++index)
+    {
+      auto& shard = m_shards[index];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      for (auto it = std::begin(shard.routes); it != std::end(shard.routes);)
+      {
+        it = idle(it->second) ? shard.routes.erase(it) : std::next(it);
+      }
+
+      for (auto it = std::begin(shard.buckets); it != std::end(shard.buckets);)
+      {
+        it = idle(it->second) ? shard.buckets.erase(it) : std::next(it);
+      }
+    }
+  }
+
+  RateLimiter::RateLimiter(TimerWheel& timers)
+    : m_timers(timers), m_shards(new Shard[SHARDS]), m_global_reset(0), m_global_timer(TimerWheel::INVALID_TIMER), m_stopping(false)
+  {
+    m_sweep_timer = m_timers.schedule_every(IDLE_TIMEOUT, [this]() { sweep(); });
+  }
+
+  RateLimiter::~RateLimiter()
+  {
+    //  Timers are cancelled outside the locks, their callbacks take them.
+    std::vector<TimerWheel::TimerId> timers;
+    m_stopping = true;
+
+    {
+      std::lock_guard<std::mutex> lock(m_global_mutex);
+      timers.push_back(m_global_timer);
+    }
+
+    for (size_t index = 0; index < SHARDS; ++index)
+    {
+      std::lock_guard<std::mutex> lock(m_shards[index].mutex);
+
+      for (auto& route_bucket : m_shards[index].routes)
+      {
+        timers.push_back(route_bucket.second->timer);
+      }
+
+      for (auto& named_bucket : m_shards[index].buckets)
+      {
+        timers.push_back(named_bucket.second->timer);
+      }
+    }
+
+    m_timers.cancel(m_sweep_timer);
+
+    for (auto timer : timers)
+    {
+      m_timers.cancel(timer);
+    }
+  }
+
+  void RateLimiter::acquire(APIKey key, Snowflake major, Start start)
+  {
+    std::vector<Start> ready;
+    auto index = shard_of(major.id());
+
+    {
+      auto& shard = m_shards[index];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto& bucket = find_route(shard, { key, major.id() });
+
+      bucket->last_used = std::chrono::steady_clock::now();
+      bucket->waiting.push_back(std::move(start));
+      release(index, bucket, ready);
+    }
+
+    for (auto& start : ready)
+    {
+      start();
+    }
+  }
+
+  void RateLimiter::complete(APIKey key, Snowflake major, const RateLimitInfo& info)
+  {
+    std::vector<Start> ready;
+    auto index = shard_of(major.id());
+
+    {
+      auto& shard = m_shards[index];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto& route_bucket = find_route(shard, { key, major.id() });
+      auto bucket = route_bucket;
+
+      if (bucket->in_flight > 0)
+      {
+        --bucket->in_flight;
+      }
+
+      //  Buckets are shared by routes with the same limit, but each major parameter is limited separately.
+      if (!info.bucket.empty() && info.bucket != bucket->name)
+      {
+        auto& shared = shard.buckets[info.bucket + ":" + major.to_string()];
+
+        if (!shared)
+        {
+          shared = make_bucket(info.bucket);
+        }
+
+        //  A bucket without a name only ever held this route, so everything in it moves over.
+        if (bucket->name.empty())
+        {
+          shared->in_flight += bucket->in_flight;
+          std::move(std::begin(bucket->waiting), std::end(bucket->waiting), std::back_inserter(shared->waiting));
+          bucket->waiting.clear();
+
+          //  The bucket is dropped below, so a callback that is already running finds nothing to pump.
+          m_timers.cancel_pending(bucket->timer);
+        }
+
+        route_bucket = shared;
+        bucket = shared;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      bucket->last_used = now;
+
+      if (info.remaining >= 0)
+      {
+        //  Requests still in flight were sent before this response counted them.
+        bucket->limit = info.limit;
+        bucket->remaining = std::max<int32_t>(0, info.remaining - static_cast<int32_t>(bucket->in_flight));
+        bucket->reset = now + info.reset_after;
+        bucket->window = std::max(bucket->window, info.reset_after);
+      }
+
+      if (info.retry_after.count() > 0)
+      {
+        if (info.global)
+        {
+          auto global_reset = (now + info.retry_after).time_since_epoch().count();
+          auto current = m_global_reset.load();
+
+          while (current < global_reset && !m_global_reset.compare_exchange_weak(current, global_reset))
+          {
+          }
+        }
+        else
+        {
+          bucket->remaining = 0;
+          bucket->reset = std::max(bucket->reset, now + info.retry_after);
+        }
+      }
+
+      release(index, bucket, ready);
+    }
+
+    for (auto& start : ready)
+    {
+      start();
+    }
+  }
+
+  int32_t RateLimiter::limit(APIKey key, Snowflake major)
+  {
+    auto& shard = m_shards[shard_of(major.id())];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.routes.find({ key, major.id() });
+
+    return found == std::end(shard.routes) ? -1 : found->second->limit;
+  }
+}
@@ -0,0 +1,189 @@
+#include "response_cache.h"
+
+namespace discord
+{
+  const size_t ResponseCache::DEFAULT_MAX_ENTRIES = 10000;
+  const size_t ResponseCache::MAX_INVALIDATIONS = 4096;
+
+  void ResponseCache::erase(std::unordered_map<std::string, Entry>::iterator entry)
+  {
+    auto route = m_routes.find({ entry->second.key, entry->second.major });
+
+    if (route != std::end(m_routes))
+    {
+      route->second.erase(entry->first);
+
+      if (route->second.empty())
+      {
+        m_routes.erase(route);
+      }
+    }
+
+    m_order.erase(entry->second.order);
+    m_entries.erase(entry);
+  }
+
+  void ResponseCache::forget_invalidations()
+  {
+    if (m_path_invalidations.size() + m_route_invalidations.size() <= MAX_INVALIDATIONS)
+    {
+      return;
+    }
+
+    m_path_invalidations.clear();
+    m_route_invalidations.clear();
+    m_floor = m_generation;
+  }
+
+  ResponseCache::ResponseCache() : m_max_entries(DEFAULT_MAX_ENTRIES), m_generation(0), m_floor(0)
+  {
+  }
+
+  void ResponseCache::set_ttl(APIKey key, std::chrono::milliseconds ttl)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (ttl.count() > 0)
+    {
+      m_ttls[key] = ttl;
+      return;
+    }
+
+    m_ttls.erase(key);
+
+    for (auto entry = std::begin(m_entries); entry != std::end(m_entries);)
+    {
+      auto next = std::next(entry);
+
+      if (entry->second.key == key)
+      {
+        erase(entry);
+      }
+
+      entry = next;
+    }
+  }
+
+  void ResponseCache::set_max_entries(size_t max_entries)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_max_entries = max_entries;
+
+    while (m_entries.size() > m_max_entries)
+    {
+      erase(m_entries.find(m_order.back()));
+    }
+  }
+
+  bool ResponseCache::cacheable(APIKey key) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ttls.count(key) != 0;
+  }
+
+  uint64_t ResponseCache::generation() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+  }
+
+  std::shared_ptr<APIResponse> ResponseCache::find(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto entry = m_entries.find(path);
+
+    if (entry == std::end(m_entries))
+    {
+      return nullptr;
+    }
+
+    if (entry->second.expires <= std::chrono::steady_clock::now())
+    {
+      erase(entry);
+      return nullptr;
+    }
+
+    m_order.splice(std::begin(m_order), m_order, entry->second.order);
+    return entry->second.response;
+  }
+
+  void ResponseCache::store(APIKey key, Snowflake major, const std::string& path, std::shared_ptr<APIResponse> response, uint64_t generation)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto ttl = m_ttls.find(key);
+
+    if (ttl == std::end(m_ttls) || generation < m_floor || m_max_entries == 0)
+    {
+      return;
+    }
+
+    //  Only an invalidation that covers this request makes its response stale.
+    auto path_invalidated = m_path_invalidations.find(path);
+    auto route_invalidated = m_route_invalidations.find({ key, major.id() });
+
+    if ((path_invalidated != std::end(m_path_invalidations) && path_invalidated->second > generation)
+      || (route_invalidated != std::end(m_route_invalidations) && route_invalidated->second > generation))
+    {
+      return;
+    }
+
+    auto existing = m_entries.find(path);
+
+    if (existing != std::end(m_entries))
+    {
+      erase(existing);
+    }
+
+    while (m_entries.size() >= m_max_entries)
+    {
+      erase(m_entries.find(m_order.back()));
+    }
+
+    m_order.push_front(path);
+
+    auto& entry = m_entries[path];
+    entry.response = std::move(response);
+    entry.expires = std::chrono::steady_clock::now() + ttl->second;
+    entry.key = key;
+    entry.major = major.id();
+    entry.order = std::begin(m_order);
+
+    m_routes[{ key, major.id() }].insert(path);
+  }
+
+  void ResponseCache::invalidate(APIKey key, Snowflake major)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_route_invalidations[{ key, major.id() }] = ++m_generation;
+    forget_invalidations();
+
+    auto route = m_routes.find({ key, major.id() });
+
+    if (route == std::end(m_routes))
+    {
+      return;
+    }
+
+    //  Erasing the last path of a route erases the route, so work from a copy.
+    auto paths = route->second;
+
+    for (const auto& path : paths)
+    {
+      erase(m_entries.find(path));
+    }
+  }
+
+  void ResponseCache::invalidate(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path_invalidations[path] = ++m_generation;
+    forget_invalidations();
+
+    auto entry = m_entries.find(path);
+
+    if (entry != std::end(m_entries))
+    {
+      erase(entry);
+    }
+  }
+}
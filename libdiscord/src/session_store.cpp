@@ -0,0 +1,165 @@
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "discord_exception.h"
+#include "session_store.h"
+
+namespace discord
+{
+  const int64_t SessionStore::MAX_SESSION_AGE = 5 * 60 * 1000;
+  const size_t SessionStore::SESSION_ID_CAPACITY = 128;
+
+  namespace
+  {
+    const uint32_t SESSION_MAGIC = 0x5344534C; //  "LSDS"
+    const uint32_t SESSION_VERSION = 1;
+  }
+
+  /** The layout of the session file. */
+  struct SessionStore::Record
+  {
+    uint32_t magic;
+    uint32_t version;
+    int32_t shard;
+    int32_t total_shards;
+    volatile uint32_t seq;
+    volatile uint32_t session_id_length;
+    volatile int64_t last_active;
+    char session_id[SESSION_ID_CAPACITY];
+  };
+
+  int64_t SessionStore::now()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  SessionStore::SessionStore(const std::string& path, int shard, int total_shards) : m_record(nullptr)
+  {
+    void* view;
+
+#ifdef _WIN32
+    m_mapping = nullptr;
+    m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+      throw DiscordException("Could not open session file " + path);
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, sizeof(Record), nullptr);
+    view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Record)) : nullptr;
+
+    if (!view)
+    {
+      if (m_mapping)
+      {
+        CloseHandle(m_mapping);
+      }
+
+      CloseHandle(m_file);
+      throw DiscordException("Could not map session file " + path);
+    }
+#else
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+
+    if (m_fd < 0)
+    {
+      throw DiscordException("Could not open session file " + path);
+    }
+
+    struct stat info;
+    if (fstat(m_fd, &info) != 0 || (info.st_size < static_cast<off_t>(sizeof(Record)) && ftruncate(m_fd, sizeof(Record)) != 0))
+    {
+      close(m_fd);
+      throw DiscordException("Could not size session file " + path);
+    }
+
+    view = mmap(nullptr, sizeof(Record), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+    if (view == MAP_FAILED)
+    {
+      close(m_fd);
+      throw DiscordException("Could not map session file " + path);
+    }
+#endif
+
+    m_record = static_cast<Record*>(view);
+
+    //  A new file, a file from another version, or one made for a different shard setup starts over.
+    if (m_record->magic != SESSION_MAGIC || m_record->version != SESSION_VERSION
+      || m_record->shard != shard || m_record->total_shards != total_shards)
+    {
+      memset(m_record, 0, sizeof(Record));
+      m_record->magic = SESSION_MAGIC;
+      m_record->version = SESSION_VERSION;
+      m_record->shard = shard;
+      m_record->total_shards = total_shards;
+    }
+  }
+
+  SessionStore::~SessionStore()
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(m_record);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    munmap(m_record, sizeof(Record));
+    close(m_fd);
+#endif
+  }
+
+  bool SessionStore::load(std::string& session_id, uint32_t& seq) const
+  {
+    auto length = m_record->session_id_length;
+
+    if (length == 0 || length > SESSION_ID_CAPACITY || now() - m_record->last_active > MAX_SESSION_AGE)
+    {
+      return false;
+    }
+
+    session_id.assign(m_record->session_id, length);
+    seq = m_record->seq;
+    return true;
+  }
+
+  void SessionStore::save_session(const std::string& session_id, uint32_t seq)
+  {
+    if (session_id.size() > SESSION_ID_CAPACITY)
+    {
+      clear();
+      return;
+    }
+
+    //  Clear the length first so a crash part way through never leaves a mangled id that looks valid.
+    m_record->session_id_length = 0;
+    memcpy(m_record->session_id, session_id.data(), session_id.size());
+    m_record->seq = seq;
+    m_record->last_active = now();
+    m_record->session_id_length = static_cast<uint32_t>(session_id.size());
+  }
+
+  void SessionStore::save_seq(uint32_t seq)
+  {
+    m_record->seq = seq;
+  }
+
+  void SessionStore::touch()
+  {
+    m_record->last_active = now();
+  }
+
+  void SessionStore::clear()
+  {
+    m_record->session_id_length = 0;
+  }
+}
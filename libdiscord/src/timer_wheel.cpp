@@ -0,0 +1,200 @@
+#include "common.h"
+#include "timer_wheel.h"
+
+namespace discord
+{
+  const std::chrono::milliseconds TimerWheel::TICK = std::chrono::milliseconds(10);
+  const size_t TimerWheel::SLOTS = 512;
+  const TimerWheel::TimerId TimerWheel::INVALID_TIMER = 0;
+
+  void TimerWheel::insert(TimerId id, std::chrono::milliseconds delay)
+  {
+    //  Always wait at least one tick, and round up so timers never fire early.
+    uint64_t ticks = (delay.count() + TICK.count() - 1) / TICK.count();
+
+    if (ticks == 0)
+    {
+      ticks = 1;
+    }
+
+    m_timers[id].rounds = (ticks - 1) / SLOTS;
+    m_slots[(m_cursor + ticks) % SLOTS].push_back(id);
+  }
+
+  void TimerWheel::advance(std::vector<std::pair<TimerId, Callback>>& due)
+  {
+    m_cursor = (m_cursor + 1) % SLOTS;
+
+    std::vector<TimerId> slot;
+    slot.swap(m_slots[m_cursor]);
+
+    for (auto id : slot)
+    {
+      auto found = m_timers.find(id);
+
+      //  Cancelled timers are only removed from the map, so skip them here.
+      if (found == std::end(m_timers))
+      {
+        continue;
+      }
+
+      auto& timer = found->second;
+
+      if (timer.rounds > 0)
+      {
+        --timer.rounds;
+        m_slots[m_cursor].push_back(id);
+        continue;
+      }
+
+      //  A repeating timer that fires more than once while catching up only runs once.
+      if (m_due.insert(id).second)
+      {
+        due.emplace_back(id, timer.callback);
+      }
+
+      if (timer.interval.count() > 0)
+      {
+        insert(id, timer.interval);
+      }
+      else
+      {
+        m_timers.erase(found);
+      }
+    }
+  }
+
+  void TimerWheel::run()
+  {
+    std::vector<std::pair<TimerId, Callback>> due;
+    auto next_tick = std::chrono::steady_clock::now() + TICK;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running)
+    {
+      m_wake.wait_until(lock, next_tick, [this]() { return !m_running; });
+
+      if (!m_running)
+      {
+        break;
+      }
+
+      //  Catch up on any ticks that were missed while callbacks were running.
+      auto now = std::chrono::steady_clock::now();
+      while (next_tick <= now)
+      {
+        advance(due);
+        next_tick += TICK;
+      }
+
+      if (due.empty())
+      {
+        continue;
+      }
+
+      //  Run callbacks without the lock so they can schedule and cancel timers.
+      for (auto& entry : due)
+      {
+        //  Cancelled after it fired but before its callback got to run.
+        if (m_due.erase(entry.first) == 0)
+        {
+          continue;
+        }
+
+        m_firing = entry.first;
+        lock.unlock();
+
+        try
+        {
+          entry.second();
+        }
+        catch (const std::exception& e)
+        {
+          LOG(ERROR) << "Exception in timer callback: " << e.what();
+        }
+
+        lock.lock();
+        m_firing = INVALID_TIMER;
+        m_callback_done.notify_all();
+      }
+
+      due.clear();
+    }
+  }
+
+  TimerWheel::TimerId TimerWheel::add(std::chrono::milliseconds delay, std::chrono::milliseconds interval, Callback callback)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto id = m_next_id++;
+    auto& timer = m_timers[id];
+    timer.interval = interval;
+    timer.callback = callback;
+    insert(id, delay);
+
+    if (!m_running)
+    {
+      m_running = true;
+      m_thread = std::thread(&TimerWheel::run, this);
+    }
+
+    return id;
+  }
+
+  TimerWheel::TimerWheel() : m_running(false), m_slots(SLOTS), m_cursor(0), m_next_id(INVALID_TIMER + 1), m_firing(INVALID_TIMER)
+  {
+  }
+
+  TimerWheel::~TimerWheel()
+  {
+    stop();
+  }
+
+  TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback)
+  {
+    return add(delay, std::chrono::milliseconds(0), callback);
+  }
+
+  TimerWheel::TimerId TimerWheel::schedule_every(std::chrono::milliseconds interval, Callback callback)
+  {
+    return add(interval, interval, callback);
+  }
+
+  void TimerWheel::cancel(TimerId id)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_timers.erase(id);
+    m_due.erase(id);
+
+    //  A callback cancelling its own timer would wait on itself.
+    if (std::this_thread::get_id() != m_thread.get_id())
+    {
+      m_callback_done.wait(lock, [this, id]() { return m_firing != id; });
+    }
+  }
+
+  void TimerWheel::cancel_pending(TimerId id)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_timers.erase(id);
+    m_due.erase(id);
+  }
+
+  void TimerWheel::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+      m_timers.clear();
+      m_due.clear();
+    }
+
+    m_wake.notify_all();
+
+    if (m_thread.joinable() && m_thread.get_id() != std::this_thread::get_id())
+    {
+      m_thread.join();
+    }
+  }
+}
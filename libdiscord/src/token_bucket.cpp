@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <cmath>
+
+#include "token_bucket.h"
+
+namespace discord
+{
+  void TokenBucket::refill()
+  {
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration<double, std::milli>(now - m_last_refill).count();
+
+    m_tokens = std::min(m_capacity, m_tokens + elapsed * m_tokens_per_ms);
+    m_last_refill = now;
+  }
+
+  TokenBucket::TokenBucket(uint32_t capacity, std::chrono::milliseconds period)
+    : m_capacity(capacity), m_tokens(capacity), m_last_refill(std::chrono::steady_clock::now())
+  {
+    m_tokens_per_ms = m_capacity / static_cast<double>(period.count());
+  }
+
+  std::chrono::milliseconds TokenBucket::try_acquire(uint32_t reserve)
+  {
+    refill();
+
+    auto needed = 1.0 + reserve;
+
+    if (m_tokens >= needed)
+    {
+      m_tokens -= 1.0;
+      return std::chrono::milliseconds(0);
+    }
+
+    auto wait = static_cast<int64_t>(std::ceil((needed - m_tokens) / m_tokens_per_ms));
+    return std::chrono::milliseconds(std::max(wait, static_cast<int64_t>(1)));
+  }
+}
@@ -0,0 +1,134 @@
+#include <cstring>
+#include <zlib.h>
+
+#include "discord_exception.h"
+#include "zlib_stream.h"
+
+namespace discord
+{
+  const uint32_t ZlibStream::SYNC_FLUSH_SUFFIX = 0x0000FFFF;
+  const size_t ZlibStream::INITIAL_BUFFER_SIZE = 64 * 1024;
+
+  int ZlibStream::inflate_buffer(const char* data, size_t size, int flush)
+  {
+    m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream->avail_in = static_cast<uInt>(size);
+    m_output_size = 0;
+
+    int ret;
+
+    do
+    {
+      //  Always keep room for a null terminator at the end of the output.
+      if (m_output.size() - m_output_size <= 1)
+      {
+        m_output.resize(m_output.size() * 2);
+      }
+
+      auto available = m_output.size() - m_output_size - 1;
+      m_stream->next_out = reinterpret_cast<Bytef *>(m_output.data() + m_output_size);
+      m_stream->avail_out = static_cast<uInt>(available);
+
+      ret = inflate(m_stream.get(), flush);
+
+      m_output_size += available - m_stream->avail_out;
+    } while (ret == Z_OK && (m_stream->avail_in > 0 || m_stream->avail_out == 0));
+
+    m_output[m_output_size] = '\0';
+
+    //  A buffer error with no input left just means there was nothing more to inflate.
+    if (ret == Z_BUF_ERROR && m_stream->avail_in == 0)
+    {
+      ret = Z_OK;
+    }
+
+    return ret;
+  }
+
+  ZlibStream::ZlibStream() : m_stream(std::make_unique<z_stream_s>()), m_output(INITIAL_BUFFER_SIZE), m_output_size(0)
+  {
+    memset(m_stream.get(), 0, sizeof(z_stream_s));
+
+    if (inflateInit(m_stream.get()) != Z_OK)
+    {
+      throw DiscordException("Could not initialize zlib Inflate");
+    }
+
+    m_output[0] = '\0';
+  }
+
+  ZlibStream::~ZlibStream()
+  {
+    inflateEnd(m_stream.get());
+  }
+
+  void ZlibStream::reset()
+  {
+    inflateReset(m_stream.get());
+    m_input.clear();
+    m_output_size = 0;
+    m_output[0] = '\0';
+  }
+
+  bool ZlibStream::push(const char* data, size_t size)
+  {
+    const char* input = data;
+    size_t input_size = size;
+
+    //  If there is a partial payload waiting, this frame continues it.
+    if (!m_input.empty())
+    {
+      m_input.insert(std::end(m_input), data, data + size);
+      input = m_input.data();
+      input_size = m_input.size();
+    }
+
+    //  A payload is only complete once it ends with the Z_SYNC_FLUSH suffix.
+    if (input_size < 4 ||
+      static_cast<uint8_t>(input[input_size - 4]) != ((SYNC_FLUSH_SUFFIX >> 24) & 0xFF) ||
+      static_cast<uint8_t>(input[input_size - 3]) != ((SYNC_FLUSH_SUFFIX >> 16) & 0xFF) ||
+      static_cast<uint8_t>(input[input_size - 2]) != ((SYNC_FLUSH_SUFFIX >> 8) & 0xFF) ||
+      static_cast<uint8_t>(input[input_size - 1]) != (SYNC_FLUSH_SUFFIX & 0xFF))
+    {
+      if (m_input.empty())
+      {
+        m_input.assign(data, data + size);
+      }
+
+      return false;
+    }
+
+    auto ret = inflate_buffer(input, input_size, Z_SYNC_FLUSH);
+    m_input.clear();
+
+    if (ret != Z_OK)
+    {
+      throw DiscordException("Error during zlib-stream decompression: (" + std::to_string(ret) + ")");
+    }
+
+    return true;
+  }
+
+  void ZlibStream::inflate_payload(const char* data, size_t size)
+  {
+    //  Each compressed payload is its own zlib stream, but resetting is much cheaper than initializing again.
+    inflateReset(m_stream.get());
+
+    auto ret = inflate_buffer(data, size, Z_NO_FLUSH);
+
+    if (ret != Z_STREAM_END)
+    {
+      throw DiscordException("Error during zlib decompression: (" + std::to_string(ret) + ")");
+    }
+  }
+
+  char* ZlibStream::data()
+  {
+    return m_output.data();
+  }
+
+  size_t ZlibStream::size() const
+  {
+    return m_output_size;
+  }
+}